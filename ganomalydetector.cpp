@@ -0,0 +1,164 @@
+#include "ganomalydetector.h"
+
+GAnomalyDetector::GAnomalyDetector(const GAnomalyRules &rules)
+    : mRules(rules),
+      mCount(0),
+      mMeanFlow(0.0),
+      mExtrusions(0),
+      mRetractsCount(0),
+      mStormMove(-1),
+      mPendingRetract(0.0),
+      mPrinting(false),
+      mTemperature(0.0f),
+      mDropFrom(0.0f),
+      mDropPending(false)
+{
+}
+
+void GAnomalyDetector::beginRead(const GCode *gcode)
+{
+    Q_UNUSED(gcode);
+    
+    mFindings.clear();
+    mCount = 0;
+    
+    mMeanFlow = 0.0;
+    mExtrusions = 0;
+    
+    mRetracts.fill(0, qMax(mRules.stormRetracts, 1));
+    mRetractsCount = 0;
+    mStormMove = -1;
+    mPendingRetract = 0.0;
+    
+    mPrinting = false;
+    mTemperature = 0.0f;
+    mDropFrom = 0.0f;
+    mDropPending = false;
+}
+
+void GAnomalyDetector::move(int m, int line, const GMove &move, const GMoveModifiers &mods)
+{
+    if (mRules.types & GAnomaly::OverExtrusion) {
+        checkFlow(m, line, move);
+    }
+    if (mRules.types & (GAnomaly::RetractStorm | GAnomaly::ZeroLengthExtrusion)) {
+        checkRetracts(m, line, move);
+    }
+    if ((mRules.types & GAnomaly::OutOfVolume) && mRules.checkVolume) {
+        checkVolume(m, line, move);
+    }
+    if (mRules.types & GAnomaly::TemperatureDrop) {
+        checkTemperature(m, line, move, mods);
+    }
+}
+
+void GAnomalyDetector::endRead(const GCode *gcode)
+{
+    Q_UNUSED(gcode);
+    
+    // Cooling down at the end is not a fault
+    mDropPending = false;
+}
+
+void GAnomalyDetector::report(GAnomaly::Type type, int move, int line, double value)
+{
+    ++mCount;
+    if (mFindings.size() < mRules.maxFindings) {
+        GAnomaly anomaly = {type, move, line, float(value)};
+        mFindings.append(anomaly);
+    }
+}
+
+void GAnomalyDetector::checkFlow(int m, int line, const GMove &move)
+{
+    if (move.type() != GMove::Extrusion || move.distance() < mRules.flowMinLength) {
+        return;
+    }
+    
+    // Spikes are kept out of the mean
+    double flow = move.flowE();
+    if (mExtrusions >= mRules.flowWarmup && flow > mRules.flowSpikeFactor * mMeanFlow) {
+        report(GAnomaly::OverExtrusion, m, line, flow);
+        return;
+    }
+    
+    // Plain mean first, then exponential
+    ++mExtrusions;
+    mMeanFlow += (flow - mMeanFlow) / qMin(mExtrusions, 256);
+}
+
+void GAnomalyDetector::checkRetracts(int m, int line, const GMove &move)
+{
+    switch (move.type()) {
+    case GMove::Suck:
+    case GMove::DestringSuck: {
+        mPendingRetract += qAbs(move.dE());
+        
+        int n = mRetracts.size();
+        mRetracts[mRetractsCount % n] = m;
+        ++mRetractsCount;
+        
+        // The next slot holds the oldest of the last n retracts
+        if ((mRules.types & GAnomaly::RetractStorm) && mRules.stormRetracts > 0 && mRetractsCount >= n) {
+            int oldest = mRetracts.at(mRetractsCount % n);
+            if (m - oldest < mRules.stormWindow && (mStormMove < 0 || m - mStormMove >= mRules.stormWindow)) {
+                report(GAnomaly::RetractStorm, m, line, n);
+                mStormMove = m;
+            }
+        }
+    }
+        break;
+    
+    case GMove::DestringPrime: {
+        double extra = move.dE() - mPendingRetract;
+        if ((mRules.types & GAnomaly::ZeroLengthExtrusion) && extra > mRules.primeTolerance) {
+            report(GAnomaly::ZeroLengthExtrusion, m, line, extra);
+        }
+        mPendingRetract = qMax(0.0, mPendingRetract - move.dE());
+    }
+        break;
+    
+    case GMove::Extrusion:
+        // The filament is at the nozzle
+        mPendingRetract = 0.0;
+        break;
+    
+    default:
+        break;
+    }
+}
+
+void GAnomalyDetector::checkVolume(int m, int line, const GMove &move)
+{
+    if (move.distance() <= 0.0) {
+        return;
+    }
+    
+    if (move.X() < mRules.minX || move.X() > mRules.maxX) {
+        report(GAnomaly::OutOfVolume, m, line, move.X());
+    } else if (move.Y() < mRules.minY || move.Y() > mRules.maxY) {
+        report(GAnomaly::OutOfVolume, m, line, move.Y());
+    } else if (move.Z() < mRules.minZ || move.Z() > mRules.maxZ) {
+        report(GAnomaly::OutOfVolume, m, line, move.Z());
+    }
+}
+
+void GAnomalyDetector::checkTemperature(int m, int line, const GMove &move, const GMoveModifiers &mods)
+{
+    float t = mods.extTemp;
+    if (mPrinting && !mDropPending && t < mTemperature - mRules.temperatureDrop) {
+        GAnomaly drop = {GAnomaly::TemperatureDrop, m, line, t};
+        mDrop = drop;
+        mDropFrom = mTemperature;
+        mDropPending = true;
+    }
+    mTemperature = t;
+    
+    if (move.type() == GMove::Extrusion) {
+        if (mDropPending && t < mDropFrom - mRules.temperatureDrop) {
+            report(mDrop.type, mDrop.move, mDrop.line, mDrop.value);
+        }
+        mDropPending = false;
+        mPrinting = true;
+    }
+}
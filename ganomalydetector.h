@@ -0,0 +1,100 @@
+#ifndef GANOMALYDETECTOR_H
+#define GANOMALYDETECTOR_H
+
+#include <QVector>
+
+#include "gmoveobserver.h"
+
+struct GAnomaly {
+    enum Type {
+        OverExtrusion = 0x1,       // Flow spike over the running mean
+        RetractStorm = 0x2,        // Many retracts within a few moves
+        ZeroLengthExtrusion = 0x4, // Prime beyond the pending retraction
+        OutOfVolume = 0x8,         // Move outside the build volume
+        TemperatureDrop = 0x10,    // Extruder cooled down between extrusions
+        AllTypes = 0x1f
+    };
+    
+    Type type;
+    int move;
+    int line;
+    float value; // Flow, retracts count, extra length, coordinate or temperature
+};
+
+struct GAnomalyRules {
+    GAnomalyRules()
+        : types(GAnomaly::AllTypes),
+          flowSpikeFactor(2.0),
+          flowWarmup(100),
+          flowMinLength(0.1),
+          stormRetracts(10),
+          stormWindow(50),
+          primeTolerance(0.05),
+          checkVolume(false),
+          minX(0.0), minY(0.0), minZ(0.0),
+          maxX(200.0), maxY(200.0), maxZ(200.0),
+          temperatureDrop(10.0),
+          maxFindings(1000) {}
+    
+    int types; // GAnomaly::Type flags to detect
+    double flowSpikeFactor; // Times the running mean flow
+    int flowWarmup; // Extrusions before the flow spikes are detected
+    double flowMinLength; // Shorter extrusions have unreliable flow
+    int stormRetracts;
+    int stormWindow; // Moves
+    double primeTolerance; // Prime length over the pending retraction
+    bool checkVolume;
+    double minX, minY, minZ;
+    double maxX, maxY, maxZ;
+    double temperatureDrop; // Degrees
+    int maxFindings; // Further findings are only counted
+};
+
+// Flags extrusion and motion faults while GCode parses a stream. Every
+// rule keeps a constant amount of state, so the memory does not grow
+// with the file and the cost per move is constant.
+class GAnomalyDetector : public GMoveObserver
+{
+public:
+    explicit GAnomalyDetector(const GAnomalyRules &rules = GAnomalyRules());
+    
+    const GAnomalyRules& rules() const { return mRules; }
+    void setRules(const GAnomalyRules &rules) { mRules = rules; } // Applies to the next read
+    
+    const QVector<GAnomaly>& findings() const { return mFindings; }
+    int findingsCount() const { return mCount; } // Including those over maxFindings
+    
+    void beginRead(const GCode *gcode);
+    void move(int m, int line, const GMove &move, const GMoveModifiers &mods);
+    void endRead(const GCode *gcode);
+
+private:
+    void report(GAnomaly::Type type, int move, int line, double value);
+    void checkFlow(int m, int line, const GMove &move);
+    void checkRetracts(int m, int line, const GMove &move);
+    void checkVolume(int m, int line, const GMove &move);
+    void checkTemperature(int m, int line, const GMove &move, const GMoveModifiers &mods);
+    
+    GAnomalyRules mRules;
+    QVector<GAnomaly> mFindings;
+    int mCount;
+    
+    // Flow
+    double mMeanFlow; // Exponential moving average
+    int mExtrusions;
+    
+    // Retracts
+    QVector<int> mRetracts; // Moves of the last retracts, circular
+    int mRetractsCount;
+    int mStormMove; // The last storm found
+    double mPendingRetract;
+    
+    // Temperature
+    bool mPrinting; // An extrusion was seen
+    float mTemperature;
+    float mDropFrom;
+    GAnomaly mDrop; // Reported if an extrusion follows before the temperature recovers
+    bool mDropPending;
+};
+
+#endif // GANOMALYDETECTOR_H
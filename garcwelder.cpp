@@ -0,0 +1,229 @@
+#include "garcwelder.h"
+
+#include "gnavigator.h"
+#include "gcodewriter.h"
+
+#include <QtConcurrent>
+#include <QtMath>
+#include <cstring>
+
+GArcWelder::GArcWelder(GNavigator *navigator)
+    : mNavigator(navigator),
+      mTolerance(0.05),
+      mMinSegments(3),
+      mMaxRadius(1000.0),
+      mFlowTolerance(0.05)
+{
+}
+
+int GArcWelder::weld()
+{
+    GNavigatorItem *root = mNavigator->root();
+    int size = root->childCount();
+    
+    QVector<QPair<int, int> > ranges(size);
+    QVector<int> rows(size);
+    for (int i = 0; i < size; ++i) {
+        GNavigatorItem *item = root->child(i);
+        ranges[i] = qMakePair(item->firstLine(), item->lastLine());
+        rows[i] = i;
+    }
+    
+    // Every layer has its own arcs, joined in order
+    QVector<QVector<Arc> > layers(size);
+    QVector<Arc> *arcs = layers.data();
+    QtConcurrent::blockingMap(rows, [this, &ranges, arcs](int row) {
+        weldLayer(ranges.at(row).first, ranges.at(row).second, arcs + row);
+    });
+    
+    mArcs.clear();
+    foreach (const QVector<Arc> &layer, layers) {
+        mArcs += layer;
+    }
+    return mArcs.size();
+}
+
+void GArcWelder::apply(GCodeWriter *writer) const
+{
+    foreach (const Arc &arc, mArcs) {
+        writer->replace(arc.firstLine, arc.lastLine, arc.text);
+    }
+}
+
+int GArcWelder::linesReplaced() const
+{
+    int lines = 0;
+    foreach (const Arc &arc, mArcs) {
+        lines += arc.lastLine - arc.firstLine + 1;
+    }
+    return lines;
+}
+
+void GArcWelder::weldLayer(int firstLine, int lastLine, QVector<Arc> *arcs) const
+{
+    const GCode *gcode = mNavigator->gcode();
+    Run run;
+    auto endRun = [this, &run, arcs]() {
+        if (run.lines.size() >= mMinSegments) {
+            weldRun(run, arcs);
+        }
+        run.lines.clear();
+        run.points.clear();
+        run.e.clear();
+    };
+    
+    for (int l = firstLine; l <= lastLine; ++l) {
+        int m = gcode->lineToMove(l);
+        if (m <= 0 || gcode->code(l) != "G1") {
+            endRun();
+            continue;
+        }
+        
+        GCodeLine line = gcode->line(l);
+        GMove move = gcode->move(m);
+        GMove previous = gcode->move(m - 1);
+        GMoveModifiers mods = gcode->state(m);
+        
+        // Only X, Y, E and F on a plane
+        bool plain = mods.positioningIsAbsolute && move.Z() == previous.Z()
+                && (move.X() != previous.X() || move.Y() != previous.Y());
+        foreach (char p, line.parameters()) {
+            plain = plain && strchr("XYEF", p) != NULL;
+        }
+        bool extruding = move.type() == GMove::Extrusion;
+        if (!plain || !(extruding || move.type() == GMove::Travel)) {
+            endRun();
+            continue;
+        }
+        
+        bool hasF = false;
+        double f = line.parameter('F', &hasF);
+        if (!run.lines.isEmpty() && (hasF || extruding != run.extruding
+                || (extruding && qAbs(move.flowE() - run.flow) > mFlowTolerance * run.flow))) {
+            endRun();
+        }
+        
+        if (run.lines.isEmpty()) {
+            run.points.append(QPointF(previous.X(), previous.Y()));
+            run.extruding = extruding;
+            run.relativeE = !mods.extrusionIsAbsolute;
+            run.flow = move.flowE();
+            run.feedrate = hasF ? f : 0.0;
+        }
+        run.lines.append(l);
+        run.points.append(QPointF(move.X(), move.Y()));
+        run.e.append(line.parameter('E'));
+    }
+    endRun();
+}
+
+// Greedy: every arc is extended over as many lines as the fit allows
+void GArcWelder::weldRun(const Run &run, QVector<Arc> *arcs) const
+{
+    int n = run.lines.size();
+    int first = 0;
+    while (first + mMinSegments <= n) {
+        int last = -1;
+        Circle best;
+        Circle circle;
+        for (int i = first + mMinSegments; i <= n && fit(run.points, first, i, &circle); ++i) {
+            last = i;
+            best = circle;
+        }
+        
+        if (last < 0) {
+            ++first;
+            continue;
+        }
+        
+        Arc arc = {run.lines.at(first), run.lines.at(last - 1), arcText(run, first, last, best)};
+        arcs->append(arc);
+        first = last;
+    }
+}
+
+// The circle through the first, middle and last points, with every point and
+// every chord within the tolerance and the points turning one way, under a turn
+bool GArcWelder::fit(const QVector<QPointF> &points, int first, int last, Circle *circle) const
+{
+    QPointF a = points.at(first);
+    QPointF b = points.at((first + last) / 2) - a;
+    QPointF c = points.at(last) - a;
+    double d = 2.0 * (b.x() * c.y() - b.y() * c.x());
+    if (qAbs(d) < 1e-12) {
+        return false;
+    }
+    
+    double b2 = b.x() * b.x() + b.y() * b.y();
+    double c2 = c.x() * c.x() + c.y() * c.y();
+    QPointF u((c.y() * b2 - b.y() * c2) / d, (b.x() * c2 - c.x() * b2) / d);
+    double r = qSqrt(u.x() * u.x() + u.y() * u.y());
+    if (r > mMaxRadius) {
+        return false;
+    }
+    
+    QPointF center = a + u;
+    bool clockwise = d < 0.0;
+    double sweep = 0.0;
+    for (int i = first; i <= last; ++i) {
+        QPointF v = points.at(i) - center;
+        if (qAbs(qSqrt(v.x() * v.x() + v.y() * v.y()) - r) > mTolerance) {
+            return false;
+        }
+        if (i == last) {
+            break;
+        }
+        
+        QPointF w = points.at(i + 1) - center;
+        double cross = v.x() * w.y() - v.y() * w.x();
+        if (cross == 0.0 || (cross < 0.0) != clockwise) {
+            return false;
+        }
+        sweep += qAbs(qAtan2(cross, v.x() * w.x() + v.y() * w.y()));
+        
+        // Sagitta
+        QPointF chord = points.at(i + 1) - points.at(i);
+        double half2 = (chord.x() * chord.x() + chord.y() * chord.y()) / 4.0;
+        if (r - qSqrt(qMax(0.0, r * r - half2)) > mTolerance) {
+            return false;
+        }
+    }
+    if (sweep >= 2.0 * M_PI) {
+        return false;
+    }
+    
+    circle->center = center;
+    circle->radius = r;
+    circle->clockwise = clockwise;
+    return true;
+}
+
+// The end of the last line, the center relative to the start, the E of
+// the lines and the feedrate of the first line of the run
+QByteArray GArcWelder::arcText(const Run &run, int first, int last, const Circle &circle) const
+{
+    QPointF start = run.points.at(first);
+    QPointF end = run.points.at(last);
+    
+    QByteArray text(circle.clockwise ? "G2" : "G3");
+    text += " X" + GCodeWriter::number(end.x(), 4);
+    text += " Y" + GCodeWriter::number(end.y(), 4);
+    text += " I" + GCodeWriter::number(circle.center.x() - start.x(), 4);
+    text += " J" + GCodeWriter::number(circle.center.y() - start.y(), 4);
+    
+    if (run.extruding) {
+        double e = run.e.at(last - 1);
+        if (run.relativeE) {
+            e = 0.0;
+            for (int i = first; i < last; ++i) {
+                e += run.e.at(i);
+            }
+        }
+        text += " E" + GCodeWriter::number(e, 5);
+    }
+    
+    if (first == 0 && run.feedrate > 0.0) {
+        text += " F" + GCodeWriter::number(run.feedrate, 3);
+    }
+    return text;
+}
@@ -0,0 +1,74 @@
+#ifndef GARCWELDER_H
+#define GARCWELDER_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QPointF>
+
+class GNavigator;
+class GCodeWriter;
+
+// Fits circular arcs to runs of G1 lines and writes them as G2/G3 through
+// a GCodeWriter. A run is a block of consecutive absolute XY moves of one
+// layer with the same Z, all extruding at about the same flow or all
+// travelling; any other line ends it, so runs stay inside the routes.
+// The arc keeps the extrusion of the lines it replaces. Layers are fitted
+// on the thread pool.
+class GArcWelder
+{
+public:
+    explicit GArcWelder(GNavigator *navigator);
+    
+    double tolerance() const { return mTolerance; }
+    void setTolerance(double mm) { mTolerance = mm; } // Of the points and chords from the arc
+    int minSegments() const { return mMinSegments; }
+    void setMinSegments(int segments) { mMinSegments = qMax(segments, 2); }
+    double maxRadius() const { return mMaxRadius; }
+    void setMaxRadius(double mm) { mMaxRadius = mm; }
+    double flowTolerance() const { return mFlowTolerance; }
+    void setFlowTolerance(double ratio) { mFlowTolerance = ratio; } // Of the flows in a run
+    
+    int weld(); // Returns the number of arcs
+    void apply(GCodeWriter *writer) const; // Replaces the welded lines
+    
+    int arcsCount() const { return mArcs.size(); }
+    int linesReplaced() const;
+
+private:
+    struct Arc {
+        int firstLine;
+        int lastLine;
+        QByteArray text;
+    };
+    
+    struct Circle {
+        QPointF center;
+        double radius;
+        bool clockwise;
+    };
+    
+    struct Run {
+        QVector<int> lines;
+        QVector<QPointF> points; // The start, then the end of every line
+        QVector<double> e;       // E parameters of the lines
+        bool extruding;
+        bool relativeE;
+        double flow;             // Of the first line
+        double feedrate;         // Of the first line, 0 if none
+    };
+    
+    void weldLayer(int firstLine, int lastLine, QVector<Arc> *arcs) const;
+    void weldRun(const Run &run, QVector<Arc> *arcs) const;
+    bool fit(const QVector<QPointF> &points, int first, int last, Circle *circle) const;
+    QByteArray arcText(const Run &run, int first, int last, const Circle &circle) const;
+    
+    GNavigator *mNavigator;
+    double mTolerance;
+    int mMinSegments;
+    double mMaxRadius;
+    double mFlowTolerance;
+    
+    QVector<Arc> mArcs;
+};
+
+#endif // GARCWELDER_H
@@ -0,0 +1,61 @@
+#include "gbgcode.h"
+
+#include <zlib.h>
+
+bool GBgcode::inflate(const QByteArray &data, int size, QByteArray *out)
+{
+    out->resize(size);
+    uLongf length = uLongf(size);
+    int result = ::uncompress(reinterpret_cast<Bytef*>(out->data()), &length,
+                              reinterpret_cast<const Bytef*>(data.constData()), uLong(data.size()));
+    return result == Z_OK && length == uLongf(size);
+}
+
+bool GBgcode::deflate(const QByteArray &data, QByteArray *out)
+{
+    uLongf length = ::compressBound(uLong(data.size()));
+    out->resize(int(length));
+    int result = ::compress2(reinterpret_cast<Bytef*>(out->data()), &length,
+                             reinterpret_cast<const Bytef*>(data.constData()), uLong(data.size()), Z_DEFAULT_COMPRESSION);
+    out->resize(int(length));
+    return result == Z_OK;
+}
+
+// LZSS bit stream, most significant bit first: a 1 tag and a literal byte,
+// or a 0 tag, the back reference offset - 1 and the count - 1. The window
+// starts zeroed.
+bool GBgcode::heatshrinkDecode(const QByteArray &data, int windowBits, int lookaheadBits, int size, QByteArray *out)
+{
+    const uchar *in = reinterpret_cast<const uchar*>(data.constData());
+    qint64 bits = qint64(data.size()) * 8;
+    qint64 pos = 0;
+    auto read = [in, &pos](int count) {
+        int value = 0;
+        for (int i = 0; i < count; ++i, ++pos) {
+            value = value << 1 | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+        }
+        return value;
+    };
+    
+    out->clear();
+    out->reserve(size);
+    while (out->size() < size) {
+        if (pos + 9 <= bits && read(1)) {
+            out->append(char(read(8)));
+            continue;
+        }
+        
+        // Zero padding in the last byte ends the stream
+        if (pos + windowBits + lookaheadBits > bits) {
+            break;
+        }
+        int offset = read(windowBits) + 1;
+        int count = read(lookaheadBits) + 1;
+        for (int i = 0; i < count && out->size() < size; ++i) {
+            int from = out->size() - offset;
+            out->append(from >= 0 ? out->at(from) : '\0');
+        }
+    }
+    
+    return out->size() == size;
+}
@@ -0,0 +1,51 @@
+#ifndef GBGCODE_H
+#define GBGCODE_H
+
+#include <QByteArray>
+
+// Binary G-code container, as written by PrusaSlicer: a file header and
+// blocks, each with a header, parameters, payload and an optional CRC32.
+// Values are little endian. See GBgcodeReader and GBgcodeWriter.
+namespace GBgcode {
+    const char Magic[] = "GCDE";
+    const quint32 Version = 1;
+    const int FileHeaderSize = 10; // Magic, version, checksum type
+    
+    enum ChecksumType {
+        NoChecksum = 0,
+        CRC32
+    };
+    
+    enum BlockType {
+        FileMetadata = 0,
+        GCodeBlock,
+        SlicerMetadata,
+        PrinterMetadata,
+        PrintMetadata,
+        Thumbnail
+    };
+    
+    enum Compression {
+        NoCompression = 0,
+        Deflate,
+        Heatshrink11,   // Window 11 bits, lookahead 4 bits
+        Heatshrink12    // Window 12 bits, lookahead 4 bits
+    };
+    
+    // The text of the G-code blocks may be packed, see GMeatPack
+    enum Encoding {
+        NoEncoding = 0, // INI for the metadata
+        MeatPack,
+        MeatPackComments
+    };
+    
+    inline int blockHeaderSize(int compression) { return compression == NoCompression ? 8 : 12; }
+    inline int blockParametersSize(int type) { return type == Thumbnail ? 6 : 2; }
+    
+    // Payloads, false on corrupt data
+    bool inflate(const QByteArray &data, int size, QByteArray *out);
+    bool deflate(const QByteArray &data, QByteArray *out);
+    bool heatshrinkDecode(const QByteArray &data, int windowBits, int lookaheadBits, int size, QByteArray *out);
+}
+
+#endif // GBGCODE_H
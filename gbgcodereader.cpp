@@ -0,0 +1,195 @@
+#include "gbgcodereader.h"
+
+#include "gmeatpack.h"
+
+#include <QtEndian>
+#include <cstring>
+#include <zlib.h>
+
+GBgcodeReader::GBgcodeReader(QIODevice *source, QObject *parent)
+    : QIODevice(parent),
+      mSource(source),
+      mChecksum(GBgcode::NoChecksum),
+      mEnded(false),
+      mTextPos(0)
+{
+}
+
+bool GBgcodeReader::isBgcode(const QByteArray &header)
+{
+    return header.startsWith(GBgcode::Magic);
+}
+
+bool GBgcodeReader::open(QIODevice::OpenMode mode)
+{
+    if ((mode & WriteOnly) || !mSource->isReadable()) {
+        return false;
+    }
+    
+    mEnded = false;
+    mError.clear();
+    mText.clear();
+    mTextPos = 0;
+    
+    QByteArray header;
+    if (!readExactly(GBgcode::FileHeaderSize, &header) || !isBgcode(header)) {
+        return fail(QString("Not a binary G-code file"));
+    }
+    
+    const uchar *h = reinterpret_cast<const uchar*>(header.constData());
+    quint32 version = qFromLittleEndian<quint32>(h + 4);
+    quint16 checksum = qFromLittleEndian<quint16>(h + 8);
+    if (version != GBgcode::Version || checksum > GBgcode::CRC32) {
+        return fail(QString("Unsupported binary G-code version"));
+    }
+    mChecksum = GBgcode::ChecksumType(checksum);
+    
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool GBgcodeReader::atEnd() const
+{
+    return mTextPos >= mText.size() && !const_cast<GBgcodeReader*>(this)->nextBlock();
+}
+
+qint64 GBgcodeReader::bytesAvailable() const
+{
+    return mText.size() - mTextPos + QIODevice::bytesAvailable();
+}
+
+qint64 GBgcodeReader::readData(char *data, qint64 maxSize)
+{
+    if (mTextPos >= mText.size() && !nextBlock()) {
+        return hasError() ? -1 : 0;
+    }
+    
+    qint64 size = qMin(maxSize, qint64(mText.size() - mTextPos));
+    memcpy(data, mText.constData() + mTextPos, size);
+    mTextPos += size;
+    return size;
+}
+
+qint64 GBgcodeReader::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+// Reads blocks up to the next G-code block with some text
+bool GBgcodeReader::nextBlock()
+{
+    while (!mEnded) {
+        if (mSource->atEnd()) {
+            mEnded = true;
+            break;
+        }
+        
+        QByteArray block;
+        if (!readExactly(8, &block)) {
+            return fail(QString("Truncated block"));
+        }
+        
+        const uchar *h = reinterpret_cast<const uchar*>(block.constData());
+        quint16 type = qFromLittleEndian<quint16>(h);
+        quint16 compression = qFromLittleEndian<quint16>(h + 2);
+        int size = int(qFromLittleEndian<quint32>(h + 4));
+        int storedSize = size;
+        if (type > GBgcode::Thumbnail || compression > GBgcode::Heatshrink12) {
+            return fail(QString("Unknown block"));
+        }
+        
+        QByteArray rest;
+        int headerSize = GBgcode::blockHeaderSize(compression);
+        if (headerSize > 8) {
+            if (!readExactly(headerSize - 8, &rest)) {
+                return fail(QString("Truncated block"));
+            }
+            storedSize = int(qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(rest.constData())));
+            block.append(rest);
+        }
+        
+        // Parameters and payload
+        int parametersSize = GBgcode::blockParametersSize(type);
+        if (size < 0 || storedSize < 0 || !readExactly(parametersSize + storedSize, &rest)) {
+            return fail(QString("Truncated block"));
+        }
+        block.append(rest);
+        
+        if (mChecksum == GBgcode::CRC32) {
+            QByteArray checksum;
+            if (!readExactly(4, &checksum)) {
+                return fail(QString("Truncated block"));
+            }
+            uLong crc = ::crc32(0L, reinterpret_cast<const Bytef*>(block.constData()), uInt(block.size()));
+            if (quint32(crc) != qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(checksum.constData()))) {
+                return fail(QString("Block checksum mismatch"));
+            }
+        }
+        
+        if (type != GBgcode::GCodeBlock) {
+            continue;
+        }
+        
+        quint16 encoding = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(block.constData()) + headerSize);
+        QByteArray payload = block.mid(headerSize + parametersSize);
+        QByteArray text;
+        bool ok = true;
+        switch (compression) {
+        case GBgcode::Deflate:
+            ok = GBgcode::inflate(payload, size, &text);
+            break;
+        
+        case GBgcode::Heatshrink11:
+            ok = GBgcode::heatshrinkDecode(payload, 11, 4, size, &text);
+            break;
+        
+        case GBgcode::Heatshrink12:
+            ok = GBgcode::heatshrinkDecode(payload, 12, 4, size, &text);
+            break;
+        
+        default:
+            text = payload;
+            break;
+        }
+        if (!ok) {
+            return fail(QString("Corrupt compressed block"));
+        }
+        
+        mText.clear();
+        mTextPos = 0;
+        if (encoding == GBgcode::NoEncoding) {
+            mText = text;
+        } else {
+            GMeatPack unpacker;
+            unpacker.decode(text, &mText);
+        }
+        if (!mText.isEmpty()) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool GBgcodeReader::readExactly(int size, QByteArray *data)
+{
+    data->resize(size);
+    int done = 0;
+    while (done < size) {
+        qint64 n = mSource->read(data->data() + done, size - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += int(n);
+    }
+    return true;
+}
+
+bool GBgcodeReader::fail(const QString &error)
+{
+    mError = error;
+    mEnded = true;
+    setErrorString(error);
+    return false;
+}
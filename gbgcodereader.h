@@ -0,0 +1,45 @@
+#ifndef GBGCODEREADER_H
+#define GBGCODEREADER_H
+
+#include <QIODevice>
+#include <QByteArray>
+
+#include "gbgcode.h"
+
+// Sequential device reading the G-code text of a binary G-code source.
+// The blocks are read and decoded one at a time as the text is consumed;
+// metadata and thumbnail blocks are skipped after their checksum is verified.
+class GBgcodeReader : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit GBgcodeReader(QIODevice *source, QObject *parent = 0);
+    
+    static bool isBgcode(const QByteArray &header); // From the first 4 bytes
+    
+    bool open(OpenMode mode); // Reads the file header
+    bool isSequential() const { return true; }
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    
+    bool hasError() const { return !mError.isEmpty(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    bool nextBlock();
+    bool readExactly(int size, QByteArray *data);
+    bool fail(const QString &error);
+    
+    QIODevice *mSource;
+    GBgcode::ChecksumType mChecksum;
+    bool mEnded;
+    QString mError;
+    
+    QByteArray mText; // Of the current G-code block
+    int mTextPos;
+};
+
+#endif // GBGCODEREADER_H
@@ -0,0 +1,170 @@
+#include "gbgcodewriter.h"
+
+#include "gmeatpack.h"
+
+#include <QtEndian>
+#include <cstring>
+#include <zlib.h>
+
+GBgcodeWriter::GBgcodeWriter(QIODevice *target, QObject *parent)
+    : QIODevice(parent),
+      mTarget(target),
+      mCompression(GBgcode::Deflate),
+      mMeatPack(true)
+{
+}
+
+GBgcodeWriter::~GBgcodeWriter()
+{
+    close();
+}
+
+void GBgcodeWriter::setCompression(GBgcode::Compression compression)
+{
+    Q_ASSERT(compression == GBgcode::NoCompression || compression == GBgcode::Deflate);
+    mCompression = compression;
+}
+
+void GBgcodeWriter::addMetadata(GBgcode::BlockType block, const QString &key, const QString &value)
+{
+    Q_ASSERT(block != GBgcode::GCodeBlock && block != GBgcode::Thumbnail);
+    mMetadata.append(qMakePair(int(block), qMakePair(key, value)));
+}
+
+// The metadata blocks go in the order the readers expect
+bool GBgcodeWriter::open(QIODevice::OpenMode mode)
+{
+    if ((mode & ReadOnly) || !mTarget->isWritable()) {
+        return false;
+    }
+    
+    mText.clear();
+    mError.clear();
+    
+    uchar header[GBgcode::FileHeaderSize];
+    memcpy(header, GBgcode::Magic, 4);
+    qToLittleEndian<quint32>(GBgcode::Version, header + 4);
+    qToLittleEndian<quint16>(GBgcode::CRC32, header + 8);
+    if (mTarget->write(reinterpret_cast<const char*>(header), sizeof(header)) != sizeof(header)) {
+        return fail(mTarget->errorString());
+    }
+    
+    bool hasFileMetadata = false;
+    for (int i = 0; i < mMetadata.size(); ++i) {
+        hasFileMetadata = hasFileMetadata || mMetadata.at(i).first == GBgcode::FileMetadata;
+    }
+    if ((hasFileMetadata && !writeMetadata(GBgcode::FileMetadata))
+            || !writeMetadata(GBgcode::PrinterMetadata)
+            || !writeMetadata(GBgcode::PrintMetadata)
+            || !writeMetadata(GBgcode::SlicerMetadata)) {
+        return false;
+    }
+    
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void GBgcodeWriter::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    
+    if (!mText.isEmpty() && !hasError()) {
+        writeGCode(mText);
+    }
+    mText.clear();
+    QIODevice::close();
+}
+
+qint64 GBgcodeWriter::readData(char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+// Blocks end after the last whole line that fits
+qint64 GBgcodeWriter::writeData(const char *data, qint64 maxSize)
+{
+    mText.append(data, int(maxSize));
+    while (mText.size() >= BlockSize) {
+        int end = mText.lastIndexOf('\n', BlockSize - 1) + 1;
+        if (end == 0) {
+            end = mText.indexOf('\n') + 1; // A longer line
+            if (end == 0) {
+                break;
+            }
+        }
+        
+        if (!writeGCode(mText.left(end))) {
+            return -1;
+        }
+        mText.remove(0, end);
+    }
+    
+    return maxSize;
+}
+
+bool GBgcodeWriter::writeMetadata(GBgcode::BlockType type)
+{
+    QByteArray ini;
+    for (int i = 0; i < mMetadata.size(); ++i) {
+        if (mMetadata.at(i).first == type) {
+            const QPair<QString, QString> &entry = mMetadata.at(i).second;
+            ini.append(entry.first.toUtf8());
+            ini.append('=');
+            ini.append(entry.second.toUtf8());
+            ini.append('\n');
+        }
+    }
+    
+    return writeBlock(type, GBgcode::NoEncoding, ini);
+}
+
+bool GBgcodeWriter::writeGCode(const QByteArray &text)
+{
+    if (mMeatPack) {
+        GMeatPack packer;
+        QByteArray packed = packer.start();
+        packer.encode(text, &packed);
+        return writeBlock(GBgcode::GCodeBlock, GBgcode::MeatPackComments, packed);
+    }
+    
+    return writeBlock(GBgcode::GCodeBlock, GBgcode::NoEncoding, text);
+}
+
+bool GBgcodeWriter::writeBlock(GBgcode::BlockType type, quint16 encoding, const QByteArray &data)
+{
+    QByteArray payload;
+    if (mCompression == GBgcode::Deflate && !GBgcode::deflate(data, &payload)) {
+        return fail(QString("Compression failed"));
+    }
+    
+    int headerSize = GBgcode::blockHeaderSize(mCompression);
+    QByteArray block(headerSize + GBgcode::blockParametersSize(type), 0);
+    uchar *h = reinterpret_cast<uchar*>(block.data());
+    qToLittleEndian<quint16>(type, h);
+    qToLittleEndian<quint16>(mCompression, h + 2);
+    qToLittleEndian<quint32>(data.size(), h + 4);
+    if (mCompression != GBgcode::NoCompression) {
+        qToLittleEndian<quint32>(payload.size(), h + 8);
+    }
+    qToLittleEndian<quint16>(encoding, h + headerSize);
+    block.append(mCompression == GBgcode::NoCompression ? data : payload);
+    
+    uchar checksum[4];
+    qToLittleEndian<quint32>(quint32(::crc32(0L, reinterpret_cast<const Bytef*>(block.constData()), uInt(block.size()))), checksum);
+    block.append(reinterpret_cast<const char*>(checksum), 4);
+    
+    if (mTarget->write(block) != block.size()) {
+        return fail(mTarget->errorString());
+    }
+    return true;
+}
+
+bool GBgcodeWriter::fail(const QString &error)
+{
+    mError = error;
+    setErrorString(error);
+    return false;
+}
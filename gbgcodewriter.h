@@ -0,0 +1,60 @@
+#ifndef GBGCODEWRITER_H
+#define GBGCODEWRITER_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+#include "gbgcode.h"
+
+// Write only device encoding G-code text into a binary G-code target.
+// Opening writes the file header and the metadata blocks, the text is
+// written in G-code blocks of whole lines and closing writes the last one.
+// GCodeWriter uses it for its Binary format.
+class GBgcodeWriter : public QIODevice
+{
+    Q_OBJECT
+public:
+    enum {
+        BlockSize = 65536 // Of the text of a G-code block
+    };
+    
+    explicit GBgcodeWriter(QIODevice *target, QObject *parent = 0);
+    ~GBgcodeWriter();
+    
+    // Deflate or no compression, applies to the next open
+    GBgcode::Compression compression() const { return mCompression; }
+    void setCompression(GBgcode::Compression compression);
+    bool meatPack() const { return mMeatPack; }
+    void setMeatPack(bool enabled) { mMeatPack = enabled; }
+    
+    // Key and value pairs of the FileMetadata, PrinterMetadata, PrintMetadata and SlicerMetadata blocks
+    void addMetadata(GBgcode::BlockType block, const QString &key, const QString &value);
+    
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const { return true; }
+    
+    bool hasError() const { return !mError.isEmpty(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    bool writeMetadata(GBgcode::BlockType type);
+    bool writeGCode(const QByteArray &text);
+    bool writeBlock(GBgcode::BlockType type, quint16 encoding, const QByteArray &data);
+    bool fail(const QString &error);
+    
+    QIODevice *mTarget;
+    GBgcode::Compression mCompression;
+    bool mMeatPack;
+    QList<QPair<int, QPair<QString, QString> > > mMetadata; // Block type, key and value
+    
+    QByteArray mText;
+    QString mError;
+};
+
+#endif // GBGCODEWRITER_H
@@ -0,0 +1,162 @@
+#include "gbitcounter.h"
+
+static const int BlockShift = 6;
+static const int BlockSize = 1 << BlockShift;
+
+GBitCounter::GBitCounter()
+{
+}
+
+void GBitCounter::fill(bool value, int size)
+{
+    mBits.fill(value, size);
+    
+    int blocks = (size + BlockSize - 1) >> BlockShift;
+    mTree.fill(0, blocks + 1);
+    if (!value) {
+        return;
+    }
+    
+    // Linear time construction from the full block counts
+    for (int b = 1; b <= blocks; ++b) {
+        mTree[b] += qMin(BlockSize, size - ((b - 1) << BlockShift));
+        int parent = b + (b & -b);
+        if (parent <= blocks) {
+            mTree[parent] += mTree.at(b);
+        }
+    }
+}
+
+void GBitCounter::clear()
+{
+    mBits.clear();
+    mTree.clear();
+}
+
+void GBitCounter::setBit(int i)
+{
+    if (!mBits.testBit(i)) {
+        mBits.setBit(i);
+        add(i >> BlockShift, 1);
+    }
+}
+
+void GBitCounter::clearBit(int i)
+{
+    if (mBits.testBit(i)) {
+        mBits.clearBit(i);
+        add(i >> BlockShift, -1);
+    }
+}
+
+bool GBitCounter::toggleBit(int i)
+{
+    bool value = !mBits.toggleBit(i);
+    add(i >> BlockShift, value ? 1 : -1);
+    return value;
+}
+
+bool GBitCounter::setBits(int first, int last, const GBitCounter *mask)
+{
+    bool changed = false;
+    int block = first >> BlockShift;
+    int delta = 0;
+    for (int i = first; i <= last; ++i) {
+        if ((i >> BlockShift) != block) {
+            add(block, delta);
+            block = i >> BlockShift;
+            delta = 0;
+        }
+        
+        if (!mBits.testBit(i) && (!mask || mask->testBit(i))) {
+            mBits.setBit(i);
+            ++delta;
+            changed = true;
+        }
+    }
+    add(block, delta);
+    
+    return changed;
+}
+
+bool GBitCounter::clearBits(int first, int last)
+{
+    bool changed = false;
+    int block = first >> BlockShift;
+    int delta = 0;
+    for (int i = first; i <= last; ++i) {
+        if ((i >> BlockShift) != block) {
+            add(block, delta);
+            block = i >> BlockShift;
+            delta = 0;
+        }
+        
+        if (mBits.testBit(i)) {
+            mBits.clearBit(i);
+            --delta;
+            changed = true;
+        }
+    }
+    add(block, delta);
+    
+    return changed;
+}
+
+void GBitCounter::toggleBits(int first, int last, const GBitCounter *mask)
+{
+    int block = first >> BlockShift;
+    int delta = 0;
+    for (int i = first; i <= last; ++i) {
+        if ((i >> BlockShift) != block) {
+            add(block, delta);
+            block = i >> BlockShift;
+            delta = 0;
+        }
+        
+        if (!mask || mask->testBit(i)) {
+            delta += mBits.toggleBit(i) ? -1 : 1;
+        }
+    }
+    add(block, delta);
+}
+
+int GBitCounter::count(int first, int last) const
+{
+    first = qMax(first, 0);
+    last = qMin(last, mBits.size() - 1);
+    if (last < first) {
+        return 0;
+    }
+    
+    return prefix(last + 1) - prefix(first);
+}
+
+void GBitCounter::add(int block, int delta)
+{
+    if (delta == 0) {
+        return;
+    }
+    
+    for (int b = block + 1; b < mTree.size(); b += b & -b) {
+        mTree[b] += delta;
+    }
+}
+
+int GBitCounter::prefix(int end) const
+{
+    int block = end >> BlockShift;
+    
+    int sum = 0;
+    for (int b = block; b > 0; b -= b & -b) {
+        sum += mTree.at(b);
+    }
+    
+    // Bits of the partial block
+    for (int i = block << BlockShift; i < end; ++i) {
+        if (mBits.testBit(i)) {
+            ++sum;
+        }
+    }
+    
+    return sum;
+}
@@ -0,0 +1,41 @@
+#ifndef GBITCOUNTER_H
+#define GBITCOUNTER_H
+
+#include <QBitArray>
+#include <QVector>
+
+// Bit array which counts the set bits of any range in O(log n).
+// Set bits are counted per block of 64 bits in a Fenwick tree.
+class GBitCounter
+{
+public:
+    GBitCounter();
+    
+    void fill(bool value, int size);
+    void clear();
+    
+    int size() const { return mBits.size(); }
+    bool testBit(int i) const { return mBits.testBit(i); }
+    const QBitArray& bits() const { return mBits; }
+    
+    void setBit(int i);
+    void clearBit(int i);
+    bool toggleBit(int i);
+    
+    // Range operations, the mask limits the bits that may be set
+    bool setBits(int first, int last, const GBitCounter *mask = 0);
+    bool clearBits(int first, int last);
+    void toggleBits(int first, int last, const GBitCounter *mask = 0);
+    
+    int count() const { return count(0, mBits.size() - 1); }
+    int count(int first, int last) const;
+    
+private:
+    void add(int block, int delta);
+    int prefix(int end) const; // Set bits in [0, end)
+    
+    QBitArray mBits;
+    QVector<int> mTree;
+};
+
+#endif // GBITCOUNTER_H
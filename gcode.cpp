@@ -1,12 +1,24 @@
 #include "gcode.h"
 
+#include "gdialect.h"
+#include "ginflatedevice.h"
+#include "gbgcodereader.h"
+
 #include <QDebug>
 #include <QFile>
+#include <QThread>
 #include <algorithm>
 
 GCode::GCode(QObject *parent) 
     : QObject(parent),
-      mSpeedUnis(Units::mmPerS)
+      mSpeedUnis(Units::mmPerS),
+      mDialect(Firmware::Marlin),
+      mTextIndexEnabled(false),
+      mSnapshotsEnabled(false),
+      mInterningEnabled(true),
+      mRevision(0),
+      mTextIndex(this),
+      mColumnsRevision(-1)
 {
 }
 
@@ -21,6 +33,8 @@ void GCode::clearData()
     mLines.clear();
     qDeleteAll(mMoves);
     mMoves.clear();
+    mTimeline.clear();
+    mTextIndex.clear();
 }
 
 void GCode::buildMapping()
@@ -39,6 +53,38 @@ void GCode::clearMapping()
     mMLMap.clear();
 }
 
+GCodeSnapshotPtr GCode::snapshot() const
+{
+    GCodeSnapshotPtr snapshot = std::atomic_load(&mSnapshot);
+    if (snapshot && snapshot->revision() != mRevision && QThread::currentThread() == thread()) {
+        publishSnapshot();
+        snapshot = std::atomic_load(&mSnapshot);
+    }
+    return snapshot;
+}
+
+// Readers keep the snapshot they hold until they release it
+void GCode::publishSnapshot() const
+{
+    GCodeSnapshotPtr snapshot;
+    if (mSnapshotsEnabled) {
+        snapshot.reset(new GCodeSnapshot(this));
+    }
+    std::atomic_store(&mSnapshot, snapshot);
+}
+
+void GCode::addObserver(GMoveObserver *observer)
+{
+    if (!mObservers.contains(observer)) {
+        mObservers.append(observer);
+    }
+}
+
+void GCode::removeObserver(GMoveObserver *observer)
+{
+    mObservers.removeAll(observer);
+}
+
 bool GCode::readFile(const QString &fileName)
 {
     QFile file(fileName);
@@ -46,6 +92,37 @@ bool GCode::readFile(const QString &fileName)
         return false;
     }
     
+    // Binary G-code is decoded a block at a time as the lines are parsed
+    if (GBgcodeReader::isBgcode(file.peek(4))) {
+        GBgcodeReader reader(&file);
+        if (!reader.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        QTextStream in(&reader);
+        bool result = readStream(&in) && !reader.hasError();
+        file.close();
+        return result;
+    }
+    
+    // Compressed files are inflated on the pool while the lines are parsed
+    switch (GInflateDevice::format(file.peek(4))) {
+    case GInflateDevice::Gzip: {
+        GInflateDevice inflater(&file);
+        inflater.open(QIODevice::ReadOnly);
+        QTextStream in(&inflater);
+        bool result = readStream(&in) && !inflater.hasError();
+        inflater.close();
+        file.close();
+        return result;
+    }
+        
+    case GInflateDevice::Zstd:
+        return false; // Not supported
+        
+    default:
+        break;
+    }
+    
     QTextStream in(&file);
     
     bool result = readStream(&in);
@@ -68,79 +145,441 @@ bool GCode::readStream(QTextStream* in)
     mSelected.clear();
     mVisible.clear();
     
+    foreach (GMoveObserver *observer, mObservers) {
+        observer->beginRead(this);
+    }
+    
+    switch (mDialect) {
+    case Firmware::RepRapFirmware:
+        parseStream<GDialect::RepRapFirmware>(in);
+        break;
+        
+    case Firmware::Klipper:
+        parseStream<GDialect::Klipper>(in);
+        break;
+        
+    default:
+        parseStream<GDialect::Marlin>(in);
+        break;
+    }
+    
+    buildMapping();
+    if (mTextIndexEnabled) {
+        mTextIndex.build();
+    }
+    ++mRevision;
+    publishSnapshot();
+    
+    foreach (GMoveObserver *observer, mObservers) {
+        observer->endRead(this);
+    }
+    
+    emit endReset();
+    return true;
+}
+
+static QString parameterText(double value)
+{
+    return QString::number(value, 'g', 10);
+}
+
+// Checked while the lines are tokenized
+QBitArray GCode::checksumErrors() const
+{
+    QBitArray lines(mLines.size());
+    for (int l = 0; l < mLines.size(); ++l) {
+        if (!mLines.at(l)->checksumValid()) {
+            lines.setBit(l);
+        }
+    }
+    
+    return lines;
+}
+
+void GCode::setParameter(int l, char p, double value)
+{
+    Q_ASSERT(l >= 0 && l < mLines.size());
+    Q_ASSERT(mLines.at(l)->type() == GCodeLine::Command);
+    
+    int bottom;
+    switch (mDialect) {
+    case Firmware::RepRapFirmware:
+        bottom = lastChangedLine<GDialect::RepRapFirmware>(l, p);
+        break;
+        
+    case Firmware::Klipper:
+        bottom = lastChangedLine<GDialect::Klipper>(l, p);
+        break;
+        
+    default:
+        bottom = lastChangedLine<GDialect::Marlin>(l, p);
+        break;
+    }
+    
+    emit aboutToChangeData(l, bottom);
+    mLines.at(l)->setParameter(p, parameterText(value));
+    updateMoves();
+    emit dataChanged(l, bottom);
+}
+
+// Positions, E and F carry over to the moves after the line until a line
+// sets them again: an absolute move or G92 for the axes, any move for F.
+// The next move always changes, its length and dE start at the line. A
+// state command holds until the same code comes again. I, J and R only
+// change their own move.
+template <class Dialect>
+int GCode::lastChangedLine(int l, char p) const
+{
+    const GCodeLine *edited = mLines.at(l);
+    GDialect::Command command = Dialect::command(*edited);
+    bool motion = command == GDialect::Linear || command == GDialect::ArcCW || command == GDialect::ArcCCW;
+    bool axis = p == 'X' || p == 'Y' || p == 'Z' || p == 'E';
+    
+    if (!motion && command != GDialect::SetPosition) {
+        for (int k = l + 1; k < mLines.size(); ++k) {
+            if (mLines.at(k)->code() == edited->code()) {
+                return k;
+            }
+        }
+        return mLines.size() - 1;
+    }
+    
+    if (!axis && p != 'F') {
+        return l;
+    }
+    
+    int next = l + 1;
+    while (next < mLines.size() - 1 && mLMMap.at(next) < 0) {
+        ++next;
+    }
+    next = qMin(next, mLines.size() - 1);
+    
+    for (int k = l + 1; k < mLines.size(); ++k) {
+        const GCodeLine *line = mLines.at(k);
+        if (!line->parameters().contains(p)) {
+            continue;
+        }
+        
+        command = Dialect::command(*line);
+        if (command == GDialect::SetPosition && axis) {
+            return qMax(k, next);
+        }
+        if ((command != GDialect::Linear && command != GDialect::ArcCW && command != GDialect::ArcCCW) || mLMMap.at(k) < 0) {
+            continue;
+        }
+        
+        const GMoveModifiers &mods = mTimeline.at(mLMMap.at(k));
+        if (p == 'F' || (p == 'E' ? mods.extrusionIsAbsolute : mods.positioningIsAbsolute)) {
+            return qMax(k, next);
+        }
+    }
+    
+    return mLines.size() - 1;
+}
+
+bool GCode::transform(const GTransform &transform)
+{
+    if (transform.isIdentity()) {
+        return true;
+    }
+    
+    // Arcs can not be scaled into ellipses
+    if (transform.hasXY() && !transform.isUniform()) {
+        foreach (const GMove *move, mMoves) {
+            if (move->arcDirection() != GMove::Undefined) {
+                return false;
+            }
+        }
+    }
+    
+    // The edited lines are known after the pass
+    emit aboutToChangeData(0, mLines.size() - 1);
+    
+    QPair<int, int> changed;
+    switch (mDialect) {
+    case Firmware::RepRapFirmware:
+        changed = transformLines<GDialect::RepRapFirmware>(transform);
+        break;
+        
+    case Firmware::Klipper:
+        changed = transformLines<GDialect::Klipper>(transform);
+        break;
+        
+    default:
+        changed = transformLines<GDialect::Marlin>(transform);
+        break;
+    }
+    
+    if (changed.first <= changed.second) {
+        // Later moves carry the new position and feedrate over
+        if (transform.hasXY() || transform.hasZ() || transform.hasFeedrate()) {
+            changed.second = mLines.size() - 1;
+        }
+        updateMoves();
+        emit dataChanged(changed.first, changed.second);
+    }
+    return true;
+}
+
+// One pass over the lines with the moves as parsed. Only the parameters
+// present on a line are rewritten, except X and Y that go in pairs. The
+// extruder position is followed, as read and as written, through G92 so
+// absolute E values stay continuous when only the extrusions are scaled.
+// Arcs are mapped by uniform transforms only: mirroring swaps G2 and G3
+// and R is scaled.
+template <class Dialect>
+QPair<int, int> GCode::transformLines(const GTransform &transform)
+{
+    int top = mLines.size();
+    int bottom = -1;
+    double sourceE = 0.0;
+    double targetE = 0.0;
+    
+    for (int l = 0; l < mLines.size(); ++l) {
+        GCodeLine *line = mLines.at(l);
+        GDialect::Command command = Dialect::command(*line);
+        bool ok = false;
+        
+        if (command == GDialect::SetPosition) {
+            double e = line->parameter('E', &ok);
+            if (ok) {
+                sourceE = e;
+                targetE = e;
+            }
+            continue;
+        }
+        
+        if (command != GDialect::Linear && command != GDialect::ArcCW && command != GDialect::ArcCCW) {
+            continue;
+        }
+        
+        int m = mLMMap.at(l);
+        const GMove *move = mMoves.at(m);
+        const GMoveModifiers &mods = mTimeline.at(m);
+        bool edited = false;
+        
+        if (transform.hasXY()) {
+            bool hasX = false;
+            bool hasY = false;
+            double x = line->parameter('X', &hasX);
+            double y = line->parameter('Y', &hasY);
+            if (hasX || hasY) {
+                QPointF p = mods.positioningIsAbsolute ? transform.map(QPointF(move->X(), move->Y())) : transform.mapVector(QPointF(x, y));
+                line->setParameter('X', parameterText(p.x()));
+                line->setParameter('Y', parameterText(p.y()));
+                edited = true;
+            }
+            
+            double i = line->parameter('I', &hasX);
+            double j = line->parameter('J', &hasY);
+            if (command != GDialect::Linear && (hasX || hasY)) {
+                QPointF v = transform.mapVector(QPointF(i, j));
+                line->setParameter('I', parameterText(v.x()));
+                line->setParameter('J', parameterText(v.y()));
+                edited = true;
+            }
+            
+            double r = line->parameter('R', &ok);
+            if (command != GDialect::Linear && ok) {
+                line->setParameter('R', parameterText(r * transform.scaleFactor()));
+                edited = true;
+            }
+            
+            if (command != GDialect::Linear && transform.isMirroring()) {
+                line->setCode(command == GDialect::ArcCW ? "G3" : "G2");
+                edited = true;
+            }
+        }
+        
+        if (transform.hasZ()) {
+            double z = line->parameter('Z', &ok);
+            if (ok) {
+                z = mods.positioningIsAbsolute ? transform.mapZ(move->Z()) : transform.mapZVector(z);
+                line->setParameter('Z', parameterText(z));
+                edited = true;
+            }
+        }
+        
+        if (transform.hasFeedrate()) {
+            double f = line->parameter('F', &ok);
+            if (ok) {
+                line->setParameter('F', parameterText(transform.mapFeedrate(f)));
+                edited = true;
+            }
+        }
+        
+        double e = line->parameter('E', &ok);
+        if (ok) {
+            double de = mods.extrusionIsAbsolute ? e - sourceE : e;
+            double targetDE = move->type() == GMove::Extrusion ? de * transform.extrusionScale() : de;
+            sourceE += de;
+            targetE += targetDE;
+            if (transform.hasExtrusion()) {
+                line->setParameter('E', parameterText(mods.extrusionIsAbsolute ? targetE : targetDE));
+                edited = true;
+            }
+        }
+        
+        if (edited) {
+            top = qMin(top, l);
+            bottom = l;
+        }
+    }
+    
+    return qMakePair(top, bottom);
+}
+
+// Same as the move pass of a read, the lines keep their parsed fields
+void GCode::updateMoves()
+{
+    clearMapping();
+    qDeleteAll(mMoves);
+    mMoves.clear();
+    mTimeline.clear();
+    
+    foreach (GMoveObserver *observer, mObservers) {
+        observer->beginRead(this);
+    }
+    
+    switch (mDialect) {
+    case Firmware::RepRapFirmware:
+        parseLines<GDialect::RepRapFirmware>();
+        break;
+        
+    case Firmware::Klipper:
+        parseLines<GDialect::Klipper>();
+        break;
+        
+    default:
+        parseLines<GDialect::Marlin>();
+        break;
+    }
+    
+    buildMapping();
+    if (mTextIndexEnabled) {
+        mTextIndex.build();
+    }
+    ++mRevision;
+    
+    foreach (GMoveObserver *observer, mObservers) {
+        observer->endRead(this);
+    }
+}
+
+template <class Dialect>
+void GCode::parseStream(QTextStream *in)
+{
+    Dialect dialect;
+    mLinePool.clear();
     while (!in->atEnd()) {
         QString line = in->readLine();
-        mLines.append(new GCodeLine(line));
+        mLines.append(mInterningEnabled ? mLinePool.create(line, dialect) : new GCodeLine(line, dialect));
     }
+    mLinePool.finish();
     
+    mSelected.fill(false, mLines.size());
+    mVisible.fill(false, mLines.size());
+    parseLines<Dialect>();
+}
+
+template <class Dialect>
+void GCode::parseLines()
+{
     int size = mLines.size();
-    mSelected.fill(false, size);
-    mVisible.fill(false, size);
     mMLMap.reserve(size);
     
     GMove *mpp = new GMove();
     GMove *mp = mpp;
     GMoveModifiers mods;
+    mods.retractLength = Dialect::defaultRetractLength();
+    GMoveModifiers pmods = mods;
+    bool absoluteExtrusion = true; // M82/M83 state
     
     for (int i = 0; i < size; ++i) {
         GCodeLine *l = mLines.at(i);
+        GDialect::Command command = Dialect::command(*l);
         
-        //@TODO: rewrite
-        if (l->code() == "G92") {
+        switch (command) {
+        case GDialect::SetPosition:
             mods.extruderShift = mp->ET() - l->parameter('E');
+            break;
+            
+        case GDialect::AbsolutePositioning:
+        case GDialect::RelativePositioning:
+            mods.positioningIsAbsolute = command == GDialect::AbsolutePositioning;
+            mods.extrusionIsAbsolute = Dialect::extrusionIsAbsolute(absoluteExtrusion, mods.positioningIsAbsolute);
+            break;
+            
+        case GDialect::AbsoluteExtrusion:
+        case GDialect::RelativeExtrusion:
+            absoluteExtrusion = command == GDialect::AbsoluteExtrusion;
+            mods.extrusionIsAbsolute = Dialect::extrusionIsAbsolute(absoluteExtrusion, mods.positioningIsAbsolute);
+            break;
+            
+        case GDialect::SpeedFactor:
+            mods.speedFactor = l->parameterFloat('S') / 100.0;
+            break;
+            
+        case GDialect::ExtrudeFactor:
+            mods.extrudeFactor = l->parameterFloat('S') / 100.0;
+            break;
             
-        } else if (l->code().startsWith('M')) {
-            if (l->code() == "M220") {
-                mods.speedFactor = l->parameterFloat('S') / 100.0;
-                
-            } else if (l->code() == "M221") {
-                mods.extrudeFactor = l->parameterFloat('S') / 100.0;
-                
-            } else if (l->code() == "M104") {
-                mods.extTemp = l->parameterFloat('S');
-                
-            } else if (l->code() == "M109") {
-                mods.extTemp = l->parameterFloat('S');
-                if (mods.extTemp == 0) {
-                    mods.extTemp = l->parameterFloat('R');
-                }
-                
-            } else if (l->code() == "M140") {
-                mods.bedTemp = l->parameterFloat('S');
-                
-            } else if (l->code() == "M190") {
-                mods.bedTemp = l->parameterFloat('S');
-                if (mods.bedTemp == 0) {
-                    mods.bedTemp = l->parameterFloat('R');
-                }
-                
-            } else if (l->code() == "M106") {
-                mods.fanSpeed = l->parameterInt('S');
-                
-            } else if (l->code() == "M107") {
-                mods.fanSpeed = 0;
-                
-            } else if (l->code() == "M82") {
-                mods.extrusionIsAbsolute = true;
-                
-            } else if (l->code() == "M83") {
-                mods.extrusionIsAbsolute = false;
+        case GDialect::ExtruderTemperature:
+            mods.extTemp = l->parameterFloat('S');
+            break;
+            
+        case GDialect::ExtruderTemperatureWait:
+            mods.extTemp = l->parameterFloat('S');
+            if (mods.extTemp == 0) {
+                mods.extTemp = l->parameterFloat('R');
+            }
+            break;
+            
+        case GDialect::BedTemperature:
+            mods.bedTemp = l->parameterFloat('S');
+            break;
+            
+        case GDialect::BedTemperatureWait:
+            mods.bedTemp = l->parameterFloat('S');
+            if (mods.bedTemp == 0) {
+                mods.bedTemp = l->parameterFloat('R');
             }
+            break;
+            
+        case GDialect::FanOn:
+            mods.fanSpeed = l->parameterInt('S');
+            break;
+            
+        case GDialect::FanOff:
+            mods.fanSpeed = 0;
+            break;
+            
+        case GDialect::Acceleration:
+            Dialect::updateAcceleration(*l, &mods);
+            break;
+            
+        case GDialect::RetractSettings:
+            Dialect::updateRetraction(*l, &mods);
+            break;
+            
+        default:
+            break;
         }
         
-        if (GMove::testCode(l->code())) {
+        if (GDialect::isMove(command)) {
             mMLMap.append(i);
-            GMove *m = new GMove(*l, *mp, mods);
+            GMove *m = new GMove(*l, command, *mp, mods, pmods);
+            mTimeline.append(mMoves.size(), mods);
+            for (int o = 0; o < mObservers.size(); ++o) {
+                mObservers.at(o)->move(mMoves.size(), i, *m, mods);
+            }
             mMoves.append(m);
             mp = m;
+            pmods = mods;
         }
     }
     delete mpp;
-    
-    buildMapping();
-    
-    emit endReset();
-    return true;
+    mTimeline.squeeze();
 }
 
 void GCode::clear()
@@ -148,9 +587,12 @@ void GCode::clear()
     emit beginReset();
     clearMapping();
     clearData();
+    mLinePool.clear();
     
     mSelected.clear();
     mVisible.clear();
+    ++mRevision;
+    publishSnapshot();
     emit endReset();
 }
 
@@ -241,13 +683,13 @@ double GCode::length(int m) const
 double GCode::Ff(int m) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    return mMoves.at(m)->Ff();
+    return mTimeline.at(m).speedFactor;
 }
 
 double GCode::Ef(int m) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    return mMoves.at(m)->Ef();
+    return mTimeline.at(m).extrudeFactor;
 }
 
 double GCode::E(int m) const
@@ -284,7 +726,7 @@ double GCode::F(int m) const
 double GCode::Fe(int m) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    float f = mMoves.at(m)->Fe();
+    float f = mMoves.at(m)->F() * mTimeline.at(m).speedFactor;
     return mSpeedUnis == Units::mmPerMin ? f : f / 60;
 }
 
@@ -309,19 +751,25 @@ double GCode::flow(int m) const
 float GCode::bedT(int m) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    return mMoves.at(m)->bedT();
+    return mTimeline.at(m).bedTemp;
 }
 
 float GCode::extT(int m, int /*e*/) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    return mMoves.at(m)->extT();
+    return mTimeline.at(m).extTemp;
 }
 
 float GCode::fanSpeed(int m) const
 {
     Q_ASSERT(m >= 0 && m < mMoves.size());
-    return mMoves.at(m)->fanSpeed();
+    return mTimeline.at(m).fanSpeed / 2.55f;
+}
+
+GMoveModifiers GCode::state(int m) const
+{
+    Q_ASSERT(m >= 0 && m < mMoves.size());
+    return mTimeline.at(m);
 }
 
 GMove::ArcDirection GCode::arcDirection(int move) const
@@ -354,6 +802,124 @@ QPointF GCode::CXY(int m) const
     return QPointF(mMoves.at(m)->CX(), mMoves.at(m)->CY());
 }
 
+// Fills buffer with VertexSize floats per move of [firstMove, lastMove].
+// Returns the number of vertices written.
+int GCode::exportVertices(int firstMove, int lastMove, float *buffer) const
+{
+    Q_ASSERT(firstMove >= 0 && lastMove < mMoves.size());
+    
+    float *v = buffer;
+    // Walk the state timeline along with the moves instead of looking it up per move
+    int c = mTimeline.indexAt(firstMove);
+    int next = c + 1 < mTimeline.changesCount() ? mTimeline.changeMove(c + 1) : mMoves.size();
+    GMoveModifiers mods = mTimeline.at(firstMove);
+    for (int m = firstMove; m <= lastMove; ++m) {
+        if (m == next) {
+            mods = mTimeline.changeState(++c);
+            next = c + 1 < mTimeline.changesCount() ? mTimeline.changeMove(c + 1) : mMoves.size();
+        }
+        const GMove *move = mMoves.at(m);
+        v[VertexX] = move->X();
+        v[VertexY] = move->Y();
+        v[VertexZ] = move->Z();
+        v[VertexMoveType] = move->type();
+        float f = move->F() * mods.speedFactor;
+        v[VertexFeedrate] = mSpeedUnis == Units::mmPerMin ? f : f / 60;
+        v[VertexFlow] = move->flowE();
+        v[VertexTemperature] = mods.extTemp;
+        v += VertexSize;
+    }
+    
+    return lastMove < firstMove ? 0 : lastMove - firstMove + 1;
+}
+
+const QVector<float> &GCode::column(GMoveQuery::Column column) const
+{
+    Q_ASSERT(column >= 0 && column < GMoveQuery::ColumnsCount);
+    
+    // Queries come from worker threads too. A filled column is not
+    // touched again until the data changes.
+    QMutexLocker locker(&mColumnsMutex);
+    if (mColumnsRevision != mRevision) {
+        mColumns = QVector<QVector<float> >(GMoveQuery::ColumnsCount);
+        mColumnsRevision = mRevision;
+    }
+    
+    QVector<float> &values = mColumns[column];
+    if (values.size() != mMoves.size()) {
+        fillColumn(column, &values);
+    }
+    
+    return values;
+}
+
+void GCode::fillColumn(GMoveQuery::Column column, QVector<float> *values) const
+{
+    values->resize(mMoves.size());
+    float *v = values->data();
+    
+    // Walk the state timeline along with the moves, as exportVertices() does
+    int c = 0;
+    int next = c + 1 < mTimeline.changesCount() ? mTimeline.changeMove(c + 1) : mMoves.size();
+    GMoveModifiers mods = mTimeline.at(0);
+    for (int m = 0; m < mMoves.size(); ++m) {
+        if (m == next) {
+            mods = mTimeline.changeState(++c);
+            next = c + 1 < mTimeline.changesCount() ? mTimeline.changeMove(c + 1) : mMoves.size();
+        }
+        
+        const GMove *move = mMoves.at(m);
+        switch (column) {
+        case GMoveQuery::X: v[m] = move->X(); break;
+        case GMoveQuery::Y: v[m] = move->Y(); break;
+        case GMoveQuery::Z: v[m] = move->Z(); break;
+        case GMoveQuery::E: v[m] = move->E(); break;
+        case GMoveQuery::Feedrate: {
+            float f = move->F() * mods.speedFactor;
+            v[m] = mSpeedUnis == Units::mmPerMin ? f : f / 60;
+        }
+            break;
+        case GMoveQuery::Flow: v[m] = move->flowE(); break;
+        case GMoveQuery::Distance: v[m] = move->distance(); break;
+        case GMoveQuery::ExtruderTemperature: v[m] = mods.extTemp; break;
+        case GMoveQuery::BedTemperature: v[m] = mods.bedTemp; break;
+        case GMoveQuery::FanSpeed: v[m] = mods.fanSpeed / 2.55f; break;
+        case GMoveQuery::MoveType: v[m] = move->type(); break;
+        default: v[m] = 0.0f; break;
+        }
+    }
+}
+
+QBitArray GCode::movesToLines(const QBitArray &moves) const
+{
+    Q_ASSERT(moves.size() <= mMLMap.size());
+    QBitArray lines(mLines.size());
+    for (int m = 0; m < moves.size(); ++m) {
+        if (moves.testBit(m)) {
+            lines.setBit(mMLMap.at(m));
+        }
+    }
+    
+    return lines;
+}
+
+QList<QPair<int, int> > GCode::ranges(const QBitArray &bits)
+{
+    QList<QPair<int, int> > runs;
+    int first = -1;
+    for (int i = 0; i <= bits.size(); ++i) {
+        bool bit = i < bits.size() && bits.testBit(i);
+        if (bit && first < 0) {
+            first = i;
+        } else if (!bit && first >= 0) {
+            runs.append(qMakePair(first, i - 1));
+            first = -1;
+        }
+    }
+    
+    return runs;
+}
+
 //double GCode::zLayer(int layer) const
 //{
 //    Q_ASSERT(layer >= 0 && layer < mZs.size());
@@ -388,15 +954,26 @@ void GCode::select(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    bool changed = false;
-    for (int i = min; i <= max; ++i) {
-        if (mVisible.testBit(i)) {
-            changed = changed || !mSelected.testBit(i);
-            mSelected.setBit(i);
+    if (mSelected.setBits(min, max, &mVisible)) {
+        emit selectionChanged(min, max);
+    }
+}
+
+void GCode::select(const QBitArray &lines)
+{
+    Q_ASSERT(lines.size() <= mLines.size());
+    int min = mLines.size();
+    int max = -1;
+    
+    typedef QPair<int, int> Range;
+    foreach (const Range &r, ranges(lines)) {
+        if (mSelected.setBits(r.first, r.second, &mVisible)) {
+            min = qMin(min, r.first);
+            max = qMax(max, r.second);
         }
     }
     
-    if (changed) {
+    if (max >= 0) {
         emit selectionChanged(min, max);
     }
 }
@@ -423,13 +1000,26 @@ void GCode::deselect(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    bool changed = false;
-    for (int i = min; i <= max; ++i) {
-        changed = changed || mSelected.testBit(i);
-        mSelected.clearBit(i);
+    if (mSelected.clearBits(min, max)) {
+        emit selectionChanged(min, max);
+    }
+}
+
+void GCode::deselect(const QBitArray &lines)
+{
+    Q_ASSERT(lines.size() <= mLines.size());
+    int min = mLines.size();
+    int max = -1;
+    
+    typedef QPair<int, int> Range;
+    foreach (const Range &r, ranges(lines)) {
+        if (mSelected.clearBits(r.first, r.second)) {
+            min = qMin(min, r.first);
+            max = qMax(max, r.second);
+        }
     }
     
-    if (changed) {
+    if (max >= 0) {
         emit selectionChanged(min, max);
     }
 }
@@ -452,11 +1042,7 @@ void GCode::toggleSelection(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    for (int i = min; i <= max; i++) {
-        if (mVisible.testBit(i)) {
-            mSelected.toggleBit(i);
-        }
-    }
+    mSelected.toggleBits(min, max, &mVisible);
     
     emit selectionChanged(min, max);
 }
@@ -482,13 +1068,26 @@ void GCode::show(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    bool changed = false;
-    for (int i = min; i <= max; i++) {
-        changed = changed || !mVisible.testBit(i);
-        mVisible.setBit(i);
+    if (mVisible.setBits(min, max)) {
+        emit visibilityChanged(min, max);
+    }
+}
+
+void GCode::show(const QBitArray &lines)
+{
+    Q_ASSERT(lines.size() <= mLines.size());
+    int min = mLines.size();
+    int max = -1;
+    
+    typedef QPair<int, int> Range;
+    foreach (const Range &r, ranges(lines)) {
+        if (mVisible.setBits(r.first, r.second)) {
+            min = qMin(min, r.first);
+            max = qMax(max, r.second);
+        }
     }
     
-    if (changed) {
+    if (max >= 0) {
         emit visibilityChanged(min, max);
     }
 }
@@ -517,14 +1116,38 @@ void GCode::hide(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    bool changed = false;
-    for (int i = min; i <= max; ++i) {
-        changed = changed || mVisible.testBit(i);
-        mVisible.clearBit(i);
+    if (mVisible.clearBits(min, max)) {
+        deselect(min, max);
+        emit visibilityChanged(min, max);
     }
+}
+
+void GCode::hide(const QBitArray &lines)
+{
+    Q_ASSERT(lines.size() <= mLines.size());
+    int min = mLines.size();
+    int max = -1;
+    int minSelected = mLines.size();
+    int maxSelected = -1;
     
-    if (changed) {
-        deselect(min, max);
+    // Hidden lines are deselected
+    typedef QPair<int, int> Range;
+    foreach (const Range &r, ranges(lines)) {
+        if (mVisible.clearBits(r.first, r.second)) {
+            min = qMin(min, r.first);
+            max = qMax(max, r.second);
+            
+            if (mSelected.clearBits(r.first, r.second)) {
+                minSelected = qMin(minSelected, r.first);
+                maxSelected = qMax(maxSelected, r.second);
+            }
+        }
+    }
+    
+    if (maxSelected >= 0) {
+        emit selectionChanged(minSelected, maxSelected);
+    }
+    if (max >= 0) {
         emit visibilityChanged(min, max);
     }
 }
@@ -548,11 +1171,9 @@ void GCode::toggleVisible(int firstLine, int lastLine)
     int min = qMin(firstLine, lastLine);
     int max = qMax(firstLine, lastLine);
 
-    bool hided = false;
-    for (int i = min; i <= max; i++) {
-        mVisible.toggleBit(i);
-        hided = hided || !mVisible.testBit(i);
-    }
+    // Every visible line of the range gets hidden
+    bool hided = mVisible.count(min, max) > 0;
+    mVisible.toggleBits(min, max);
     
     if (hided) {
         deselect(min, max);
@@ -7,14 +7,26 @@
 #include <QBitArray>
 #include <QPointF>
 #include <QTextStream>
+#include <QPair>
+#include <QMutex>
 
 #include "gcodelib.h"
 #include "gcodeline.h"
 #include "gmove.h"
+#include "gstatetimeline.h"
+#include "gbitcounter.h"
+#include "gmovequery.h"
+#include "gtextindex.h"
+#include "gmoveobserver.h"
+#include "gtransform.h"
+#include "gcodesnapshot.h"
+#include "glinepool.h"
 
 class GCode : public QObject
 {
     Q_OBJECT
+    friend class GCodeSnapshot;
+    
 public:
     explicit GCode(QObject *parent = 0);
     ~GCode();
@@ -22,10 +34,29 @@ public:
     bool readFile(const QString &fileName);
     bool readText(const QString &text);
     bool readStream(QTextStream *in);
+    
+    Firmware::Dialect dialect() const { return mDialect; }
+    void setDialect(Firmware::Dialect dialect) { mDialect = dialect; } // Applies to the next read
+    Units::SpeedUnits speedUnits() const { return mSpeedUnis; }
+    
+    // Observers see the moves of the next reads as they are parsed
+    void addObserver(GMoveObserver *observer);
+    void removeObserver(GMoveObserver *observer);
 
     int linesCount() const { return mLines.size(); }
     int movesCount() const { return mMoves.size(); }
 //    int zCount() const { return mZs.size(); }
+    int revision() const { return mRevision; } // Bumped on every data reset or change
+    
+    // Snapshots for readers on other threads, see GCodeSnapshot. The
+    // current one is swapped atomically, NULL when disabled. A read
+    // publishes one at once, an edit leaves it stale: the next snapshot()
+    // on the thread of the GCode copies the file, once for a run of edits.
+    // Other threads get the last one published, so hand them a snapshot
+    // taken on the thread of the GCode after editing.
+    bool snapshotsEnabled() const { return mSnapshotsEnabled; }
+    void setSnapshotsEnabled(bool enabled) { mSnapshotsEnabled = enabled; } // Applies to the next read
+    GCodeSnapshotPtr snapshot() const;
     
     void clear();
     
@@ -36,6 +67,14 @@ public:
     QString comment(int l) const { return mLines.at(l)->comment(); }
     GCodeLine::LineType lineType(int l) const { return mLines.at(l)->type(); }
     QString code(int l) const { return mLines.at(l)->code(); }
+    bool modified(int l) const { return mLines.at(l)->modified(); }
+    int lineNumber(int l) const { return mLines.at(l)->lineNumber(); } // N of a logged serial line
+    bool checksumValid(int l) const { return mLines.at(l)->checksumValid(); }
+    QBitArray checksumErrors() const; // Lines with a wrong checksum
+    
+    // Editing. The moves are rebuilt from the parsed lines on every edit.
+    void setParameter(int l, char p, double value);
+    bool transform(const GTransform &transform); // Edits the parameters of G0-G3 moves, false if it would distort arcs
 
     // Moves
     GMove move(int m) const { return *(mMoves.at(m)); }
@@ -75,33 +114,78 @@ public:
     QPointF CXY(int m) const;
     GMove::ArcDirection arcDirection(int move) const;
     
+    // Modal state
+    GMoveModifiers state(int m) const;
+    const GStateTimeline& timeline() const { return mTimeline; }
+    
+    // Vertex export
+    enum VertexAttribute {
+        VertexX = 0,
+        VertexY,
+        VertexZ,
+        VertexMoveType,
+        VertexFeedrate, // Effective feedrate, see Fe()
+        VertexFlow,     // Effective flow, see flow()
+        VertexTemperature, // Extruder temperature, see extT()
+        VertexSize
+    };
+    
+    int exportVertices(int firstMove, int lastMove, float *buffer) const;
+    
+    // Move queries, see GMoveQuery
+    QBitArray query(const GMoveQuery &query) const { return query.evaluate(this); }
+    const QVector<float>& column(GMoveQuery::Column column) const; // Cached until the data changes
+    QBitArray movesToLines(const QBitArray &moves) const;
+    static QList<QPair<int, int> > ranges(const QBitArray &bits); // First and last index of the runs of set bits
+    
+    // Text search, see GTextIndex. Matching lines are returned as ranges.
+    bool textIndexEnabled() const { return mTextIndexEnabled; }
+    void setTextIndexEnabled(bool enabled) { mTextIndexEnabled = enabled; } // Applies to the next read
+    const GTextIndex& textIndex() const { return mTextIndex; }
+    QList<QPair<int, int> > find(const QString &text) const { return GTextIndex::ranges(mTextIndex.find(text)); }
+    QList<QPair<int, int> > find(const QRegExp &rx) const { return GTextIndex::ranges(mTextIndex.find(rx)); }
+    QList<QPair<int, int> > findCode(const QString &code) const { return GTextIndex::ranges(mTextIndex.linesWithCode(code)); }
+    
+    // Repeated text shares its storage, see GLinePool
+    bool interningEnabled() const { return mInterningEnabled; }
+    void setInterningEnabled(bool enabled) { mInterningEnabled = enabled; } // Applies to the next read
+    const GLinePool& linePool() const { return mLinePool; } // Counts of the last read
+    double dedupRatio() const { return mLinePool.ratio(); }
+    
     // Selection
-    bool selected(int l) const { return mSelected.at(l); }
-    QBitArray selection() const { return mSelected; }
+    bool selected(int l) const { return mSelected.testBit(l); }
+    QBitArray selection() const { return mSelected.bits(); }
+    int selectedCount(int firstLine, int lastLine) const { return mSelected.count(firstLine, lastLine); }
     void selectAll();
     void select(int l);
     void select(int firstLine, int lastLine);
+    void select(const QBitArray &lines);
     void deselectAll();
     void deselect(int l);
     void deselect(int firstLine, int lastLine);
+    void deselect(const QBitArray &lines);
     bool toggleSelection(int l);
     void toggleSelection(int firstLine, int lastLine);
     
     // Visibility
     bool visible(int l) const { return mVisible.testBit(l); }
-    QBitArray visibility() const { return mVisible; }
+    QBitArray visibility() const { return mVisible.bits(); }
+    int visibleCount(int firstLine, int lastLine) const { return mVisible.count(firstLine, lastLine); }
     void showAll();
     void show(int l);
     void show(int firstLine, int lastLine);
+    void show(const QBitArray &lines);
     void hideAll();
     void hide(int l);
     void hide(int firstLine, int lastLine);
+    void hide(const QBitArray &lines);
     bool toggleVisible(int l);
     void toggleVisible(int firstLine, int lastLine);
     
 signals:
     void beginReset();
     void endReset();
+    void aboutToChangeData(int top, int bottom); // Before the lines and moves are edited in place
     void dataChanged(int top, int bottom);
     void selectionChanged(int top, int bottom);
     void visibilityChanged(int top, int bottom);
@@ -110,16 +194,37 @@ public slots:
     
 private:
     void clearData();
+    template <class Dialect> void parseStream(QTextStream *in);
+    template <class Dialect> void parseLines();
+    template <class Dialect> QPair<int, int> transformLines(const GTransform &transform);
+    template <class Dialect> int lastChangedLine(int l, char p) const;
+    void updateMoves();
+    void publishSnapshot() const;
+    void fillColumn(GMoveQuery::Column column, QVector<float> *values) const;
     void buildMapping();
     void clearMapping();
     
     Units::SpeedUnits mSpeedUnis;
+    Firmware::Dialect mDialect;
+    bool mTextIndexEnabled;
+    bool mSnapshotsEnabled;
+    bool mInterningEnabled;
+    int mRevision;
+    mutable GCodeSnapshotPtr mSnapshot;
     
     QList<GCodeLine*> mLines;
     QList<GMove*> mMoves;
+    GStateTimeline mTimeline;
+    GTextIndex mTextIndex;
+    GLinePool mLinePool;
+    QList<GMoveObserver*> mObservers;
+    
+    mutable QVector<QVector<float> > mColumns;
+    mutable int mColumnsRevision;
+    mutable QMutex mColumnsMutex;
     
-    QBitArray mSelected;
-    QBitArray mVisible;
+    GBitCounter mSelected;
+    GBitCounter mVisible;
     
     QVector<int> mMLMap;
     QVector<int> mLMMap;
@@ -0,0 +1,315 @@
+#include "gcodediff.h"
+
+#include "gcode.h"
+
+#include <QtConcurrent>
+
+GCodeDiff::GCodeDiff(GCode *a, GCode *b)
+    : mA(a),
+      mB(b),
+      mTolerance(1e-3)
+{
+}
+
+void GCodeDiff::compare()
+{
+    mLayerChanges.clear();
+    mHunks.clear();
+    mNumericChanges.clear();
+    
+    QVector<Layer> layersA = splitLayers(mA);
+    QVector<Layer> layersB = splitLayers(mB);
+    
+    // Layers are aligned on Z rounded to 0.1 um
+    QVector<uint> zA;
+    QVector<uint> zB;
+    foreach (const Layer &layer, layersA) {
+        zA.append(qHash(qRound64(layer.z * 1e4)));
+    }
+    foreach (const Layer &layer, layersB) {
+        zB.append(qHash(qRound64(layer.z * 1e4)));
+    }
+    
+    Matches matches;
+    diff(zA.constData(), zA.size(), zB.constData(), zB.size(), 0, 0, &matches);
+    matches.append(qMakePair(layersA.size(), layersB.size()));
+    
+    QVector<Job> jobs;
+    int pa = 0;
+    int pb = 0;
+    for (int i = 0; i < matches.size(); ++i) {
+        int ma = matches.at(i).first;
+        int mb = matches.at(i).second;
+        
+        // Layers missing on one side
+        if (ma > pa || mb > pb) {
+            Hunk hunk;
+            hunk.firstA = pa < layersA.size() ? layersA.at(pa).firstLine : mA->linesCount();
+            hunk.lastA = ma > pa ? layersA.at(ma - 1).lastLine : hunk.firstA - 1;
+            hunk.firstB = pb < layersB.size() ? layersB.at(pb).firstLine : mB->linesCount();
+            hunk.lastB = mb > pb ? layersB.at(mb - 1).lastLine : hunk.firstB - 1;
+            
+            Job job;
+            job.hunks.append(hunk);
+            for (int l = pa; l < ma; ++l) {
+                LayerChange change = {layersA.at(l).z, layersA.at(l).firstLine, layersA.at(l).lastLine, hunk.firstB, hunk.firstB - 1};
+                job.layers.append(change);
+            }
+            for (int l = pb; l < mb; ++l) {
+                LayerChange change = {layersB.at(l).z, hunk.firstA, hunk.firstA - 1, layersB.at(l).firstLine, layersB.at(l).lastLine};
+                job.layers.append(change);
+            }
+            jobs.append(job);
+        }
+        
+        if (ma < layersA.size() && mb < layersB.size()) {
+            const Layer &a = layersA.at(ma);
+            const Layer &b = layersB.at(mb);
+            if (a.hash != b.hash || a.keys.size() != b.keys.size()) {
+                jobs.append(Job(&a, &b));
+            }
+        }
+        
+        pa = ma + 1;
+        pb = mb + 1;
+    }
+    
+    QtConcurrent::blockingMap(jobs, [this](Job &job) {
+        if (job.a) {
+            compareLayers(job);
+        }
+    });
+    
+    // Jobs are in file order
+    foreach (const Job &job, jobs) {
+        mLayerChanges += job.layers;
+        mHunks += job.hunks;
+        mNumericChanges += job.changes;
+    }
+}
+
+// Splits the document where Z changes, as GNavigator does, and hashes
+// the lines of every layer on the thread pool
+QVector<GCodeDiff::Layer> GCodeDiff::splitLayers(GCode *gcode) const
+{
+    QVector<Layer> layers;
+    if (gcode->linesCount() == 0) {
+        return layers;
+    }
+    
+    Layer layer;
+    layer.firstLine = 0;
+    layer.z = 0.0;
+    layer.hash = 0;
+    
+    for (int move = 0; move < gcode->movesCount(); ++move) {
+        double zm = gcode->Z(move);
+        if (qAbs(zm - layer.z) > Layers::zTolerance) {
+            int line = gcode->moveToLine(move);
+            layer.lastLine = line - 1;
+            layers.append(layer);
+            
+            layer.firstLine = line;
+            layer.z = zm;
+        }
+    }
+    
+    layer.lastLine = gcode->linesCount() - 1;
+    layers.append(layer);
+    
+    QtConcurrent::blockingMap(layers, [gcode](Layer &layer) {
+        layer.keys.reserve(layer.lastLine - layer.firstLine + 1);
+        for (int l = layer.firstLine; l <= layer.lastLine; ++l) {
+            layer.hash = layer.hash * 31 + qHash(gcode->text(l));
+            layer.keys.append(lineKey(gcode, l));
+        }
+    });
+    
+    return layers;
+}
+
+void GCodeDiff::compareLayers(GCodeDiff::Job &job) const
+{
+    const Layer &a = *job.a;
+    const Layer &b = *job.b;
+    
+    Matches matches;
+    diff(a.keys.constData(), a.keys.size(), b.keys.constData(), b.keys.size(), a.firstLine, b.firstLine, &matches);
+    appendHunks(matches, a.firstLine, a.lastLine, b.firstLine, b.lastLine, &job.hunks);
+    
+    typedef QPair<int, int> Match;
+    foreach (const Match &match, matches) {
+        if (mA->text(match.first) != mB->text(match.second)) {
+            compareNumbers(match.first, match.second, &job.changes);
+        }
+    }
+    
+    if (!job.hunks.isEmpty() || !job.changes.isEmpty()) {
+        LayerChange change = {a.z, a.firstLine, a.lastLine, b.firstLine, b.lastLine};
+        job.layers.append(change);
+    }
+}
+
+// The lines have the same code and parameter names
+void GCodeDiff::compareNumbers(int lineA, int lineB, QList<GCodeDiff::NumericChange> *changes) const
+{
+    GCodeLine a = mA->line(lineA);
+    GCodeLine b = mB->line(lineB);
+    if (a.command() == b.command()) {
+        return;
+    }
+    
+    foreach (char p, a.parameters()) {
+        double va = a.parameter(p);
+        double vb = b.parameter(p);
+        if (qAbs(va - vb) > mTolerance) {
+            NumericChange change = {lineA, lineB, p, va, vb};
+            changes->append(change);
+        }
+    }
+}
+
+// Lines with parameters are keyed by their code and parameter names, so
+// the lines differing in numbers only are aligned
+uint GCodeDiff::lineKey(const GCode *gcode, int line)
+{
+    if (gcode->lineType(line) != GCodeLine::Command) {
+        return qHash(gcode->text(line));
+    }
+    
+    GCodeLine l = gcode->line(line);
+    if (l.parameters().isEmpty()) {
+        return qHash(l.command());
+    }
+    
+    uint key = qHash(l.code());
+    foreach (char p, l.parameters()) {
+        key = key * 31 + uchar(p);
+    }
+    
+    return key;
+}
+
+void GCodeDiff::appendHunks(const Matches &matches, int firstA, int lastA, int firstB, int lastB, QList<GCodeDiff::Hunk> *hunks)
+{
+    int pa = firstA;
+    int pb = firstB;
+    for (int i = 0; i <= matches.size(); ++i) {
+        int ma = i < matches.size() ? matches.at(i).first : lastA + 1;
+        int mb = i < matches.size() ? matches.at(i).second : lastB + 1;
+        if (ma > pa || mb > pb) {
+            Hunk hunk = {pa, ma - 1, pb, mb - 1};
+            hunks->append(hunk);
+        }
+        pa = ma + 1;
+        pb = mb + 1;
+    }
+}
+
+// Appends the aligned index pairs, offset, in order
+void GCodeDiff::diff(const uint *a, int n, const uint *b, int m, int offsetA, int offsetB, Matches *matches)
+{
+    int prefix = 0;
+    while (prefix < n && prefix < m && a[prefix] == b[prefix]) {
+        matches->append(qMakePair(offsetA + prefix, offsetB + prefix));
+        ++prefix;
+    }
+    a += prefix;
+    b += prefix;
+    n -= prefix;
+    m -= prefix;
+    offsetA += prefix;
+    offsetB += prefix;
+    
+    int suffix = 0;
+    while (suffix < n && suffix < m && a[n - suffix - 1] == b[m - suffix - 1]) {
+        ++suffix;
+    }
+    n -= suffix;
+    m -= suffix;
+    
+    if (n > 0 && m > 0) {
+        QPair<int, int> split = bisect(a, n, b, m);
+        diff(a, split.first, b, split.second, offsetA, offsetB, matches);
+        diff(a + split.first, n - split.first, b + split.second, m - split.second,
+             offsetA + split.first, offsetB + split.second, matches);
+    }
+    
+    for (int i = 0; i < suffix; ++i) {
+        matches->append(qMakePair(offsetA + n + i, offsetB + m + i));
+    }
+}
+
+// Finds the middle of an edit path walking forward and backward at once,
+// in linear space. The sequences have different first and last items.
+QPair<int, int> GCodeDiff::bisect(const uint *a, int n, const uint *b, int m)
+{
+    int maxD = (n + m + 1) / 2;
+    int offset = maxD;
+    int length = 2 * maxD + 2;
+    QVector<int> v1(length, -1);
+    QVector<int> v2(length, -1);
+    v1[offset + 1] = 0;
+    v2[offset + 1] = 0;
+    
+    int delta = n - m;
+    bool front = delta % 2 != 0; // The forward path finds the overlap
+    int k1start = 0;
+    int k1end = 0;
+    int k2start = 0;
+    int k2end = 0;
+    
+    for (int d = 0; d < maxD; ++d) {
+        for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+            int k1Offset = offset + k1;
+            int x1 = (k1 == -d || (k1 != d && v1.at(k1Offset - 1) < v1.at(k1Offset + 1)))
+                    ? v1.at(k1Offset + 1) : v1.at(k1Offset - 1) + 1;
+            int y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1]) {
+                ++x1;
+                ++y1;
+            }
+            v1[k1Offset] = x1;
+            
+            if (x1 > n) {
+                k1end += 2;  // Off the right
+            } else if (y1 > m) {
+                k1start += 2; // Off the bottom
+            } else if (front) {
+                int k2Offset = offset + delta - k1;
+                if (k2Offset >= 0 && k2Offset < length && v2.at(k2Offset) != -1 && x1 >= n - v2.at(k2Offset)) {
+                    return qMakePair(x1, y1);
+                }
+            }
+        }
+        
+        for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+            int k2Offset = offset + k2;
+            int x2 = (k2 == -d || (k2 != d && v2.at(k2Offset - 1) < v2.at(k2Offset + 1)))
+                    ? v2.at(k2Offset + 1) : v2.at(k2Offset - 1) + 1;
+            int y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1]) {
+                ++x2;
+                ++y2;
+            }
+            v2[k2Offset] = x2;
+            
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                int k1Offset = offset + delta - k2;
+                if (k1Offset >= 0 && k1Offset < length && v1.at(k1Offset) != -1) {
+                    int x1 = v1.at(k1Offset);
+                    if (x1 >= n - x2) {
+                        return qMakePair(x1, x1 - (k1Offset - offset));
+                    }
+                }
+            }
+        }
+    }
+    
+    // Nothing in common
+    return qMakePair(n, 0);
+}
@@ -0,0 +1,95 @@
+#ifndef GCODEDIFF_H
+#define GCODEDIFF_H
+
+#include <QList>
+#include <QVector>
+#include <QPair>
+
+class GCode;
+
+// Structural diff between two documents. Layers are aligned by Z and
+// the layers with the same hash are skipped. Lines of the other layers are
+// aligned by command and parameter names with Myers' linear space diff,
+// on the thread pool, and the parameters of the aligned lines are compared
+// as numbers. Changes not above the tolerance, formatting and the comments
+// of command lines are ignored.
+class GCodeDiff
+{
+public:
+    // Lines [firstA, lastA] of the first document are replaced by
+    // [firstB, lastB] of the second, either range may be empty
+    struct Hunk {
+        int firstA;
+        int lastA;
+        int firstB;
+        int lastB;
+    };
+    
+    struct NumericChange {
+        int lineA;
+        int lineB;
+        char parameter;
+        double a;
+        double b;
+    };
+    
+    // Layer which differs, the line range is empty on the side it is missing
+    struct LayerChange {
+        double z;
+        int firstLineA;
+        int lastLineA;
+        int firstLineB;
+        int lastLineB;
+    };
+    
+    GCodeDiff(GCode *a, GCode *b);
+    
+    double tolerance() const { return mTolerance; }
+    void setTolerance(double tolerance) { mTolerance = tolerance; }
+    
+    void compare();
+    
+    bool isEqual() const { return mLayerChanges.isEmpty(); }
+    const QList<LayerChange>& layerChanges() const { return mLayerChanges; }
+    const QList<Hunk>& hunks() const { return mHunks; }
+    const QList<NumericChange>& numericChanges() const { return mNumericChanges; }
+
+private:
+    struct Layer {
+        int firstLine;
+        int lastLine;
+        double z;
+        uint hash;         // Of the line texts
+        QVector<uint> keys; // Line keys: command and parameter names, or the text
+    };
+    
+    // Pair of aligned layers with different hashes, or layers missing on one side
+    struct Job {
+        Job(const Layer *a = 0, const Layer *b = 0) : a(a), b(b) {}
+        const Layer *a;
+        const Layer *b;
+        QList<LayerChange> layers;
+        QList<Hunk> hunks;
+        QList<NumericChange> changes;
+    };
+    
+    typedef QVector<QPair<int, int> > Matches;
+    
+    QVector<Layer> splitLayers(GCode *gcode) const;
+    void compareLayers(Job &job) const;
+    void compareNumbers(int lineA, int lineB, QList<NumericChange> *changes) const;
+    static uint lineKey(const GCode *gcode, int line);
+    static void appendHunks(const Matches &matches, int firstA, int lastA, int firstB, int lastB, QList<Hunk> *hunks);
+    static void diff(const uint *a, int n, const uint *b, int m, int offsetA, int offsetB, Matches *matches);
+    static QPair<int, int> bisect(const uint *a, int n, const uint *b, int m);
+    
+    GCode *mA;
+    GCode *mB;
+    double mTolerance;
+    
+    QList<LayerChange> mLayerChanges;
+    QList<Hunk> mHunks;
+    QList<NumericChange> mNumericChanges;
+};
+
+#endif // GCODEDIFF_H
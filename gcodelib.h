@@ -8,5 +8,18 @@ namespace Units {
     };
 }
 
+namespace Firmware {
+    enum Dialect {
+        Marlin,
+        RepRapFirmware,
+        Klipper
+    };
+}
+
+namespace Layers {
+    // A layer takes the moves this close to the Z it starts at
+    const double zTolerance = 1e-5;
+}
+
 #endif // GCODELIB_H
 
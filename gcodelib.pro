@@ -1,22 +1,72 @@
 QT       -= gui
+QT       += concurrent
 
 TARGET = gcodelib
 TEMPLATE = lib
-CONFIG += staticlib
+CONFIG += staticlib c++11
+
+LIBS += -lz
 
 SOURCES += gcode.cpp \
     gmove.cpp \
     gnavigator.cpp \
     gnavigatoritem.cpp \
-    gcodeline.cpp
+    gcodeline.cpp \
+    gvertexbuffer.cpp \
+    gstatetimeline.cpp \
+    gdialect.cpp \
+    gbitcounter.cpp \
+    gmovequery.cpp \
+    gtextindex.cpp \
+    gcodediff.cpp \
+    ghistogram.cpp \
+    gstatistics.cpp \
+    ganomalydetector.cpp \
+    gcodewriter.cpp \
+    gtransform.cpp \
+    ginflatedevice.cpp \
+    gbgcode.cpp \
+    gbgcodereader.cpp \
+    gbgcodewriter.cpp \
+    gmeatpack.cpp \
+    garcwelder.cpp \
+    gsender.cpp \
+    gcodesnapshot.cpp \
+    glinepool.cpp
 
 HEADERS += gcode.h \
     gmove.h \
     gcodelib.h \
     gnavigator.h \
     gnavigatoritem.h \
-    gcodeline.h
+    gcodeline.h \
+    gvertexbuffer.h \
+    gstatetimeline.h \
+    gdialect.h \
+    gbitcounter.h \
+    gmovequery.h \
+    gtextindex.h \
+    gcodediff.h \
+    gmoveobserver.h \
+    ghistogram.h \
+    gstatistics.h \
+    ganomalydetector.h \
+    gcodewriter.h \
+    gtransform.h \
+    ginflatedevice.h \
+    gbgcode.h \
+    gbgcodereader.h \
+    gbgcodewriter.h \
+    gmeatpack.h \
+    garcwelder.h \
+    gsender.h \
+    gcodesnapshot.h \
+    glinepool.h
 unix {
+    SOURCES += gttydevice.cpp \
+        gprintersimulator.cpp
+    HEADERS += gttydevice.h \
+        gprintersimulator.h
     target.path = /usr/lib
     INSTALLS += target
 }
@@ -1,5 +1,9 @@
 #include "gcodeline.h"
 
+#include "gdialect.h"
+
+#include <cstring>
+
 const QRegExp commentsSplitter(";");
 const QRegExp fieldsSplitter("\\s");
 
@@ -8,16 +12,25 @@ GCodeLine::GCodeLine()
       mLineType(Empty),
       mCommand(QString()),
       mComment(QString()),
-      mSelected(false)
+      mLineNumber(-1),
+      mChecksum(-1),
+      mChecksumValid(true),
+      mSelected(false),
+      mModified(false)
 {
 }
 
-GCodeLine::GCodeLine(const QString &line)
+template <class Dialect>
+GCodeLine::GCodeLine(const QString &line, const Dialect &)
     : mLine(line),
       mLineType(Empty),
       mCommand(QString()),
       mComment(QString()),
-      mSelected(false)
+      mLineNumber(-1),
+      mChecksum(-1),
+      mChecksumValid(true),
+      mSelected(false),
+      mModified(false)
 {
     if (line.length() > 0) {
         int pos = line.indexOf(commentsSplitter);
@@ -35,19 +48,16 @@ GCodeLine::GCodeLine(const QString &line)
             mLineType = Command;
         }
         
-        if (mCommand.startsWith("M117", Qt::CaseInsensitive)) {
-            mCommand = "M117" + mCommand.mid(4);
-            
-        } else {
-            mCommand = mCommand.toUpper();
+        if (mLineType == Command) {
+            splitFraming();
         }
+        mCommand = Dialect::normalize(mCommand);
         
         if (mLineType == Command) {
             mFields = mCommand.split(fieldsSplitter, QString::SkipEmptyParts);
         }
         
-        QString c = code();
-        if (!(c.isEmpty() || c == "M117")) {
+        if (Dialect::hasParameters(code())) {
             for (int i = 1; i < mFields.size(); i++) {
                 QString f = mFields[i];
                 char p = f.at(0).toUpper().toLatin1();
@@ -58,6 +68,92 @@ GCodeLine::GCodeLine(const QString &line)
     }
 }
 
+template GCodeLine::GCodeLine(const QString &, const GDialect::Marlin &);
+template GCodeLine::GCodeLine(const QString &, const GDialect::RepRapFirmware &);
+template GCodeLine::GCodeLine(const QString &, const GDialect::Klipper &);
+
+// Words of the UTF-16 units are XORed eight bytes at a time, then folded
+// to the low byte of a unit. The high bytes of Latin-1 text are zero.
+static int checksumOf(const QChar *text, int size)
+{
+    quint64 x = 0;
+    int i = 0;
+    for (; i + 4 <= size; i += 4) {
+        quint64 w;
+        memcpy(&w, text + i, sizeof(w));
+        x ^= w;
+    }
+    x ^= x >> 32;
+    x ^= x >> 16;
+    
+    for (; i < size; ++i) {
+        x ^= text[i].unicode();
+    }
+    return int(x & 0xff);
+}
+
+static int checksumOf(const char *text, int size)
+{
+    quint64 x = 0;
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 w;
+        memcpy(&w, text + i, sizeof(w));
+        x ^= w;
+    }
+    x ^= x >> 32;
+    x ^= x >> 16;
+    x ^= x >> 8;
+    
+    for (; i < size; ++i) {
+        x ^= uchar(text[i]);
+    }
+    return int(x & 0xff);
+}
+
+int GCodeLine::checksum(const QString &text)
+{
+    return checksumOf(text.constData(), text.size());
+}
+
+int GCodeLine::checksum(const QByteArray &text)
+{
+    return checksumOf(text.constData(), text.size());
+}
+
+// Only lines with a leading N word are framed, as hosts send them; a
+// '*' elsewhere is text, like in M117 messages. The checksum covers the
+// command up to the asterisk, as the host sent it.
+void GCodeLine::splitFraming()
+{
+    int size = mCommand.size();
+    if (size < 2 || (mCommand.at(0) != 'N' && mCommand.at(0) != 'n') || !mCommand.at(1).isDigit()) {
+        return;
+    }
+    
+    int end = 2;
+    while (end < size && mCommand.at(end).isDigit()) {
+        ++end;
+    }
+    if (end < size && !mCommand.at(end).isSpace() && mCommand.at(end) != '*') {
+        return;
+    }
+    mLineNumber = mCommand.mid(1, end - 1).toInt();
+    
+    int star = mCommand.lastIndexOf('*');
+    if (star >= end) {
+        bool ok;
+        int value = mCommand.mid(star + 1).trimmed().toInt(&ok);
+        if (ok && value >= 0 && value <= 255) {
+            mChecksum = value;
+            mChecksumValid = checksumOf(mCommand.constData(), star) == value;
+            mCommand = mCommand.left(star);
+        }
+    }
+    
+    mCommand = mCommand.mid(end).trimmed();
+}
+
 QString GCodeLine::code() const
 {
     if (mFields.isEmpty()) {
@@ -99,6 +195,24 @@ QString GCodeLine::parameterStr(const char &p, bool *ok) const
     return QString();
 }
 
+QString GCodeLine::namedParameter(const QString &name, bool *ok) const
+{
+    QString key = name + '=';
+    for (int i = 1; i < mFields.size(); i++) {
+        if (mFields.at(i).startsWith(key, Qt::CaseInsensitive)) {
+            if (ok) {
+                *ok = true;
+            }
+            return mFields.at(i).mid(key.size());
+        }
+    }
+    
+    if (ok) {
+        *ok = false;
+    }
+    return QString();
+}
+
 void GCodeLine::select()
 {
     mSelected = true;
@@ -115,3 +229,41 @@ bool GCodeLine::toggleSelection()
     return mSelected;
 }
 
+void GCodeLine::setCode(const QString &code)
+{
+    Q_ASSERT(mLineType == Command && !mFields.isEmpty());
+    
+    mFields[0] = code;
+    mCommand = mFields.join(' ');
+    mLine = mComment.isEmpty() ? mCommand : mCommand + " ;" + mComment;
+    mModified = true;
+    mLineNumber = -1;
+    mChecksum = -1;
+    mChecksumValid = true;
+}
+
+// Replaces the value, or appends the parameter, and rebuilds the text
+void GCodeLine::setParameter(char p, const QString &value)
+{
+    Q_ASSERT(mLineType == Command && !mFields.isEmpty());
+    
+    QString field = QChar(p) + value;
+    int i = mKeys.indexOf(p);
+    if (i < 0) {
+        mKeys.append(p);
+        mFields.append(field);
+    } else {
+        mFields[i + 1] = field;
+    }
+    mParameters.insert(p, value);
+    
+    mCommand = mFields.join(' ');
+    mLine = mComment.isEmpty() ? mCommand : mCommand + " ;" + mComment;
+    mModified = true;
+    
+    // The edited line is not the one that was sent
+    mLineNumber = -1;
+    mChecksum = -1;
+    mChecksumValid = true;
+}
+
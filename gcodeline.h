@@ -8,6 +8,7 @@
 class GCodeLine 
 {
     friend class GCode;
+    friend class GLinePool;
     
 public:
     enum LineType {
@@ -25,19 +26,32 @@ public:
     QString comment() const { return mComment; }
     LineType type() const { return mLineType; }
     
+    // Serial host framing, N<number> ... *<checksum>, kept out of the fields
+    int lineNumber() const { return mLineNumber; } // -1 if none
+    int checksum() const { return mChecksum; } // -1 if none
+    bool checksumValid() const { return mChecksumValid; } // Also if there is no checksum
+    static int checksum(const QString &text); // XOR of the characters
+    static int checksum(const QByteArray &text);
+    
     bool selected() const { return mSelected; }
+    bool modified() const { return mModified; } // Edited since the read
 
     QList<char> parameters() const { return mKeys; }
     double parameter(const char &p, bool *ok = 0) const;
     float parameterFloat(const char &p, bool *ok = 0) const;
     int parameterInt(const char &p, bool *ok = 0) const;
     QString parameterStr(const char &p, bool *ok = 0) const;
+    QString namedParameter(const QString &name, bool *ok = 0) const; // NAME=value fields
     
 private:
-    explicit GCodeLine(const QString &text);
+    template <class Dialect> 
+    GCodeLine(const QString &text, const Dialect &dialect);
     void select();
     void deselect();
     bool toggleSelection();
+    void setParameter(char p, const QString &value);
+    void setCode(const QString &code);
+    void splitFraming();
     
 private:
     
@@ -50,7 +64,12 @@ private:
     QList<char> mKeys;
     QMap<char, QString> mParameters;
     
+    int mLineNumber;
+    int mChecksum;
+    bool mChecksumValid;
+    
     bool mSelected;
+    bool mModified;
 };
 
 #endif // GCODELINE_H
@@ -0,0 +1,96 @@
+#include "gcodesnapshot.h"
+
+#include "gcode.h"
+
+#include <algorithm>
+
+GCodeSnapshot::GCodeSnapshot()
+    : mRevision(0),
+      mSpeedUnits(Units::mmPerS)
+{
+}
+
+GCodeSnapshot::GCodeSnapshot(const GCode *gcode)
+    : mRevision(gcode->mRevision),
+      mSpeedUnits(gcode->mSpeedUnis),
+      mTimeline(gcode->mTimeline),
+      mMLMap(gcode->mMLMap),
+      mLMMap(gcode->mLMMap)
+{
+    mLines.reserve(gcode->mLines.size());
+    foreach (const GCodeLine *line, gcode->mLines) {
+        mLines.append(*line);
+    }
+    
+    // The navigator's first layer is at 0, the moves before the first Z
+    // change fall into it
+    double z = 0.0;
+    mMoves.reserve(gcode->mMoves.size());
+    foreach (const GMove *move, gcode->mMoves) {
+        bool step = qAbs(move->Z() - z) > Layers::zTolerance;
+        if (step) {
+            z = move->Z();
+        }
+        if (mMoves.isEmpty() || step) {
+            mLayerMoves.append(mMoves.size());
+            mLayerZ.append(z);
+        }
+        mMoves.append(*move);
+    }
+}
+
+int GCodeSnapshot::lineToMove(int l) const
+{
+    if (l < 0 || l >= mLMMap.size()) {
+        return -1;
+    }
+    return mLMMap.at(l);
+}
+
+int GCodeSnapshot::lineToMoveForward(int l) const
+{
+    if (l < 0 || l >= mLMMap.size()) {
+        return -1;
+    }
+    
+    int m = mLMMap.at(l++);
+    while (m < 0 && l < mLMMap.size()) {
+        m = mLMMap.at(l++);
+    }
+    return m < 0 ? mMoves.size() - 1 : m;
+}
+
+int GCodeSnapshot::lineToMoveBackward(int l) const
+{
+    if (l < 0 || l >= mLMMap.size()) {
+        return -1;
+    }
+    
+    int m = mLMMap.at(l--);
+    while (m < 0 && l >= 0) {
+        m = mLMMap.at(l--);
+    }
+    return (m < 0 && !mMoves.isEmpty()) ? 0 : m;
+}
+
+int GCodeSnapshot::moveToLine(int m) const
+{
+    if (m < 0 || m >= mMLMap.size()) {
+        return -1;
+    }
+    return mMLMap.at(m);
+}
+
+int GCodeSnapshot::layerLastMove(int i) const
+{
+    Q_ASSERT(i >= 0 && i < mLayerMoves.size());
+    return i + 1 < mLayerMoves.size() ? mLayerMoves.at(i + 1) - 1 : mMoves.size() - 1;
+}
+
+int GCodeSnapshot::layerAt(int m) const
+{
+    if (m < 0 || m >= mMoves.size()) {
+        return -1;
+    }
+    return int(std::upper_bound(mLayerMoves.constBegin(), mLayerMoves.constEnd(), m) - mLayerMoves.constBegin()) - 1;
+}
@@ -0,0 +1,72 @@
+#ifndef GCODESNAPSHOT_H
+#define GCODESNAPSHOT_H
+
+#include <QVector>
+#include <memory>
+
+#include "gcodelib.h"
+#include "gcodeline.h"
+#include "gmove.h"
+#include "gstatetimeline.h"
+
+class GCode;
+
+// An immutable copy of the parsed document at a revision. GCode publishes
+// a new one after every read, and after edits when one is asked for. The strings are implicitly shared
+// with the GCode, so a copy costs a reference per field. Any number of
+// threads can read a snapshot they hold without locks while the next one
+// is built. Selection and visibility are not part of it.
+class GCodeSnapshot
+{
+    friend class GCode;
+
+public:
+    GCodeSnapshot(); // Empty
+    
+    int revision() const { return mRevision; }
+    Units::SpeedUnits speedUnits() const { return mSpeedUnits; }
+    
+    // G-Code Lines
+    int linesCount() const { return mLines.size(); }
+    const GCodeLine& line(int l) const { return mLines.at(l); }
+    QString text(int l) const { return mLines.at(l).text(); }
+    QString command(int l) const { return mLines.at(l).command(); }
+    QString code(int l) const { return mLines.at(l).code(); }
+    
+    // Moves
+    int movesCount() const { return mMoves.size(); }
+    const GMove& move(int m) const { return mMoves.at(m); }
+    int lineToMove(int l) const;
+    int lineToMoveForward(int l) const;
+    int lineToMoveBackward(int l) const;
+    int moveToLine(int m) const;
+    
+    // Modal state
+    const GStateTimeline& timeline() const { return mTimeline; }
+    const GMoveModifiers& state(int m) const { return mTimeline.at(m); }
+    
+    // Layers are the runs of moves within Layers::zTolerance of the Z they
+    // start at, as GNavigator groups them, in file order
+    int layersCount() const { return mLayerMoves.size(); }
+    int layerFirstMove(int i) const { return mLayerMoves.at(i); }
+    int layerLastMove(int i) const;
+    double layerZ(int i) const { return mLayerZ.at(i); }
+    int layerAt(int m) const; // The layer of the move
+
+private:
+    explicit GCodeSnapshot(const GCode *gcode);
+    
+    int mRevision;
+    Units::SpeedUnits mSpeedUnits;
+    QVector<GCodeLine> mLines;
+    QVector<GMove> mMoves;
+    GStateTimeline mTimeline;
+    QVector<int> mMLMap;
+    QVector<int> mLMMap;
+    QVector<int> mLayerMoves; // First move of every layer
+    QVector<double> mLayerZ;
+};
+
+typedef std::shared_ptr<const GCodeSnapshot> GCodeSnapshotPtr;
+
+#endif // GCODESNAPSHOT_H
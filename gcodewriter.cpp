@@ -0,0 +1,190 @@
+#include "gcodewriter.h"
+
+#include "gcode.h"
+#include "gbgcodewriter.h"
+
+#include <QFile>
+
+GCodeWriter::GCodeWriter(const GCode *gcode)
+    : mGCode(gcode),
+      mFormat(Text),
+      mFilter(AllLines),
+      mPrecision(5),
+      mBufferSize(1 << 20),
+      mLinesWritten(0)
+{
+}
+
+bool GCodeWriter::writeFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        mErrorString = file.errorString();
+        return false;
+    }
+    
+    bool result = write(&file);
+    file.close();
+    return result;
+}
+
+bool GCodeWriter::write(QIODevice *device)
+{
+    if (mFormat == Binary) {
+        GBgcodeWriter encoder(device);
+        if (!encoder.open(QIODevice::WriteOnly)) {
+            mErrorString = encoder.errorString();
+            return false;
+        }
+        
+        bool result = writeLines(&encoder);
+        encoder.close();
+        if (encoder.hasError()) {
+            mErrorString = encoder.errorString();
+            return false;
+        }
+        return result;
+    }
+    
+    return writeLines(device);
+}
+
+bool GCodeWriter::writeLines(QIODevice *device)
+{
+    mLinesWritten = 0;
+    mErrorString.clear();
+    mBuffer.clear();
+    mBuffer.reserve(mBufferSize);
+    
+    QBitArray lines = mask();
+    int size = mGCode->linesCount();
+    int r = 0;
+    for (int l = 0; l < size; ++l) {
+        if (!lines.isEmpty() && !lines.testBit(l)) {
+            continue;
+        }
+        
+        while (r < mReplacements.size() && mReplacements.at(r).lastLine < l) {
+            ++r;
+        }
+        
+        if (r < mReplacements.size() && mReplacements.at(r).firstLine <= l) {
+            const Replacement &replacement = mReplacements.at(r++);
+            mBuffer.append(replacement.text);
+            l = replacement.lastLine;
+        } else if (mGCode->modified(l)) {
+            serialize(mGCode->line(l));
+        } else {
+            mBuffer.append(mGCode->text(l).toUtf8());
+        }
+        mBuffer.append('\n');
+        ++mLinesWritten;
+        
+        if (mBuffer.size() >= mBufferSize && !flush(device)) {
+            return false;
+        }
+    }
+    
+    return flush(device);
+}
+
+void GCodeWriter::replace(int firstLine, int lastLine, const QByteArray &text)
+{
+    Q_ASSERT(firstLine <= lastLine);
+    Q_ASSERT(mReplacements.isEmpty() || mReplacements.last().lastLine < firstLine);
+    Replacement replacement = {firstLine, lastLine, text};
+    mReplacements.append(replacement);
+}
+
+QByteArray GCodeWriter::number(double value, int decimals)
+{
+    QByteArray number = QByteArray::number(value, 'f', decimals);
+    if (number.contains('.')) {
+        int end = number.size();
+        while (number.at(end - 1) == '0') {
+            --end;
+        }
+        if (number.at(end - 1) == '.') {
+            --end;
+        }
+        number.truncate(end);
+    }
+    if (number == "-0") {
+        number = "0";
+    }
+    return number;
+}
+
+// Empty when all the lines are written
+QBitArray GCodeWriter::mask() const
+{
+    switch (mFilter) {
+    case VisibleLines:
+        return mGCode->visibility();
+    
+    case HiddenLines:
+        return ~mGCode->visibility();
+    
+    case SelectedLines:
+        return mGCode->selection();
+    
+    case UnselectedLines:
+        return ~mGCode->selection();
+    
+    default:
+        return QBitArray();
+    }
+}
+
+// Code and parameters are separated by single spaces, numbers are trimmed of trailing zeros
+void GCodeWriter::serialize(const GCodeLine &line)
+{
+    QStringList fields = line.fields();
+    QList<char> keys = line.parameters();
+    for (int i = 0; i < fields.size(); ++i) {
+        if (i > 0) {
+            mBuffer.append(' ');
+        }
+        
+        bool ok = false;
+        double value = 0.0;
+        if (i > 0 && i <= keys.size()) {
+            // Fields without a number, like the axes of G28 X Y, are copied as they are
+            QString text = line.parameterStr(keys.at(i - 1));
+            if (!text.isEmpty()) {
+                value = text.toDouble(&ok);
+            }
+        }
+        
+        if (ok) {
+            mBuffer.append(keys.at(i - 1));
+            mBuffer.append(number(value, mPrecision));
+        } else {
+            mBuffer.append(fields.at(i).toUtf8());
+        }
+    }
+    
+    if (!line.comment().isEmpty()) {
+        mBuffer.append(fields.isEmpty() ? ";" : " ;");
+        mBuffer.append(line.comment().toUtf8());
+    }
+}
+
+bool GCodeWriter::flush(QIODevice *device)
+{
+    const char *data = mBuffer.constData();
+    qint64 left = mBuffer.size();
+    while (left > 0) {
+        qint64 n = device->write(data, left);
+        if (n < 0) {
+            mErrorString = device->errorString();
+            return false;
+        }
+        data += n;
+        left -= n;
+    }
+    
+    mBuffer.clear();
+    mBuffer.reserve(mBufferSize);
+    return true;
+}
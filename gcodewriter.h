@@ -0,0 +1,83 @@
+#ifndef GCODEWRITER_H
+#define GCODEWRITER_H
+
+#include <QByteArray>
+#include <QBitArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+class GCode;
+class GCodeLine;
+
+// Writes the lines of a GCode, or a part of them picked by the selection
+// and visibility masks. Lines not edited since the read are copied as they
+// were read; edited lines are written from their fields with the number
+// format of the writer. Output goes through a buffer of bufferSize bytes.
+// Other text can be written in place of ranges of lines. The Binary
+// format writes binary G-code through a GBgcodeWriter.
+class GCodeWriter
+{
+public:
+    enum Filter {
+        AllLines = 0,
+        VisibleLines,
+        HiddenLines,
+        SelectedLines,
+        UnselectedLines
+    };
+    
+    enum Format {
+        Text = 0,
+        Binary
+    };
+    
+    explicit GCodeWriter(const GCode *gcode);
+    
+    Format format() const { return mFormat; }
+    void setFormat(Format format) { mFormat = format; }
+    Filter filter() const { return mFilter; }
+    void setFilter(Filter filter) { mFilter = filter; }
+    int precision() const { return mPrecision; }
+    void setPrecision(int decimals) { mPrecision = decimals; } // Of the numbers in the edited lines
+    int bufferSize() const { return mBufferSize; }
+    void setBufferSize(int bytes) { mBufferSize = qMax(bytes, 1); }
+    
+    bool writeFile(const QString &fileName);
+    bool write(QIODevice *device);
+    
+    // Text written once in place of a range of lines, without the last newline.
+    // Ranges are added in ascending order and do not overlap.
+    void replace(int firstLine, int lastLine, const QByteArray &text);
+    void clearReplacements() { mReplacements.clear(); }
+    
+    int linesWritten() const { return mLinesWritten; }
+    QString errorString() const { return mErrorString; }
+    
+    static QByteArray number(double value, int decimals); // Without the trailing zeros
+
+private:
+    struct Replacement {
+        int firstLine;
+        int lastLine;
+        QByteArray text;
+    };
+    
+    bool writeLines(QIODevice *device);
+    QBitArray mask() const;
+    void serialize(const GCodeLine &line);
+    bool flush(QIODevice *device);
+    
+    const GCode *mGCode;
+    Format mFormat;
+    Filter mFilter;
+    int mPrecision;
+    int mBufferSize;
+    QVector<Replacement> mReplacements;
+    
+    QByteArray mBuffer;
+    int mLinesWritten;
+    QString mErrorString;
+};
+
+#endif // GCODEWRITER_H
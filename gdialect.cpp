@@ -0,0 +1,237 @@
+#include "gdialect.h"
+
+#include "gcodeline.h"
+#include "gmove.h"
+
+static GDialect::Command standardCommand(const QString &code)
+{
+    if (code.size() < 2) {
+        return GDialect::Other;
+    }
+    
+    bool ok = false;
+    int n = code.midRef(1).toInt(&ok);
+    if (!ok) {
+        return GDialect::Other;
+    }
+    
+    if (code.at(0) == 'G') {
+        switch (n) {
+        case 0:
+        case 1: return GDialect::Linear;
+        case 2: return GDialect::ArcCW;
+        case 3: return GDialect::ArcCCW;
+        case 10: return GDialect::Retract;
+        case 11: return GDialect::Recover;
+        case 28: return GDialect::Home;
+        case 90: return GDialect::AbsolutePositioning;
+        case 91: return GDialect::RelativePositioning;
+        case 92: return GDialect::SetPosition;
+        default: break;
+        }
+        
+    } else if (code.at(0) == 'M') {
+        switch (n) {
+        case 82: return GDialect::AbsoluteExtrusion;
+        case 83: return GDialect::RelativeExtrusion;
+        case 104: return GDialect::ExtruderTemperature;
+        case 109: return GDialect::ExtruderTemperatureWait;
+        case 140: return GDialect::BedTemperature;
+        case 190: return GDialect::BedTemperatureWait;
+        case 106: return GDialect::FanOn;
+        case 107: return GDialect::FanOff;
+        case 204: return GDialect::Acceleration;
+        case 207:
+        case 208: return GDialect::RetractSettings;
+        case 220: return GDialect::SpeedFactor;
+        case 221: return GDialect::ExtrudeFactor;
+        default: break;
+        }
+    }
+    
+    return GDialect::Other;
+}
+
+// Message commands keep the text case
+static QString normalizeMessage(const QString &command, const char *code)
+{
+    return code + command.mid(4);
+}
+
+// Marlin
+
+QString GDialect::Marlin::normalize(const QString &command)
+{
+    if (command.startsWith("M117", Qt::CaseInsensitive)) {
+        return normalizeMessage(command, "M117");
+        
+    } else if (command.startsWith("M118", Qt::CaseInsensitive)) {
+        return normalizeMessage(command, "M118");
+    }
+    
+    return command.toUpper();
+}
+
+bool GDialect::Marlin::hasParameters(const QString &code)
+{
+    return !(code.isEmpty() || code == "M117" || code == "M118");
+}
+
+GDialect::Command GDialect::Marlin::command(const GCodeLine &line)
+{
+    return standardCommand(line.code());
+}
+
+void GDialect::Marlin::updateAcceleration(const GCodeLine &line, GMoveModifiers *mods)
+{
+    bool ok = false;
+    float a = line.parameterFloat('P', &ok);
+    if (!ok) {
+        a = line.parameterFloat('S', &ok);
+    }
+    if (ok) {
+        mods->acceleration = a;
+    }
+}
+
+void GDialect::Marlin::updateRetraction(const GCodeLine &line, GMoveModifiers *mods)
+{
+    bool ok = false;
+    float s = line.parameterFloat('S', &ok);
+    if (!ok) {
+        return;
+    }
+    
+    if (line.code() == "M207") {
+        mods->retractLength = s;
+    } else {
+        mods->recoverExtraLength = s;
+    }
+}
+
+// RepRapFirmware
+
+QString GDialect::RepRapFirmware::normalize(const QString &command)
+{
+    if (command.startsWith("M291", Qt::CaseInsensitive)) {
+        return normalizeMessage(command, "M291");
+    }
+    
+    return Marlin::normalize(command);
+}
+
+bool GDialect::RepRapFirmware::hasParameters(const QString &code)
+{
+    return Marlin::hasParameters(code) && code != "M291";
+}
+
+GDialect::Command GDialect::RepRapFirmware::command(const GCodeLine &line)
+{
+    Command c = standardCommand(line.code());
+    
+    // G10 with parameters sets tool offsets and temperatures
+    if (c == Retract && !line.parameters().isEmpty()) {
+        return Other;
+    }
+    
+    // M208 sets axis limits
+    if (c == RetractSettings && line.code() != "M207") {
+        return Other;
+    }
+    
+    return c;
+}
+
+void GDialect::RepRapFirmware::updateAcceleration(const GCodeLine &line, GMoveModifiers *mods)
+{
+    bool ok = false;
+    float a = line.parameterFloat('P', &ok);
+    if (ok) {
+        mods->acceleration = a;
+    }
+}
+
+// Klipper
+
+bool GDialect::Klipper::isExtended(const QString &code)
+{
+    return code.size() > 1 && !code.at(1).isDigit();
+}
+
+QString GDialect::Klipper::normalize(const QString &command)
+{
+    if (isExtended(command)) {
+        // Only the command name is case insensitive, the values are not
+        int pos = 0;
+        while (pos < command.size() && !command.at(pos).isSpace()) {
+            ++pos;
+        }
+        return command.left(pos).toUpper() + command.mid(pos);
+    }
+    
+    return Marlin::normalize(command);
+}
+
+bool GDialect::Klipper::hasParameters(const QString &code)
+{
+    return Marlin::hasParameters(code) && !isExtended(code);
+}
+
+GDialect::Command GDialect::Klipper::command(const GCodeLine &line)
+{
+    QString code = line.code();
+    if (isExtended(code)) {
+        if (code == "SET_RETRACTION") {
+            return RetractSettings;
+            
+        } else if (code == "SET_VELOCITY_LIMIT") {
+            return Acceleration;
+        }
+        return Other;
+    }
+    
+    Command c = standardCommand(code);
+    
+    // M207/M208 are not implemented, SET_RETRACTION is used instead
+    return c == RetractSettings ? Other : c;
+}
+
+void GDialect::Klipper::updateAcceleration(const GCodeLine &line, GMoveModifiers *mods)
+{
+    bool ok = false;
+    if (line.code() == "SET_VELOCITY_LIMIT") {
+        float a = line.namedParameter("ACCEL", &ok).toFloat();
+        if (ok) {
+            mods->acceleration = a;
+        }
+        return;
+    }
+    
+    float a = line.parameterFloat('S', &ok);
+    if (ok) {
+        mods->acceleration = a;
+        return;
+    }
+    
+    // Without S the lower of P and T is used
+    bool okT = false;
+    float p = line.parameterFloat('P', &ok);
+    float t = line.parameterFloat('T', &okT);
+    if (ok && okT) {
+        mods->acceleration = qMin(p, t);
+    }
+}
+
+void GDialect::Klipper::updateRetraction(const GCodeLine &line, GMoveModifiers *mods)
+{
+    bool ok = false;
+    QString v = line.namedParameter("RETRACT_LENGTH", &ok);
+    if (ok) {
+        mods->retractLength = v.toFloat();
+    }
+    
+    v = line.namedParameter("UNRETRACT_EXTRA_LENGTH", &ok);
+    if (ok) {
+        mods->recoverExtraLength = v.toFloat();
+    }
+}
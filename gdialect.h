@@ -0,0 +1,83 @@
+#ifndef GDIALECT_H
+#define GDIALECT_H
+
+#include <QString>
+
+#include "gcodelib.h"
+
+class GCodeLine;
+struct GMoveModifiers;
+
+// Firmware dialect policies. GCode picks the policy once per read and
+// instantiates the tokenizer and the state machine with it, so the
+// per line code has no dialect checks.
+namespace GDialect {
+    enum Command {
+        Other = 0,
+        
+        // Moves
+        Linear,     // G0, G1
+        ArcCW,      // G2
+        ArcCCW,     // G3
+        Home,       // G28
+        Retract,    // Firmware retract
+        Recover,    // Firmware unretract
+        
+        // State changes
+        AbsolutePositioning,    // G90
+        RelativePositioning,    // G91
+        SetPosition,            // G92
+        AbsoluteExtrusion,      // M82
+        RelativeExtrusion,      // M83
+        ExtruderTemperature,    // M104
+        ExtruderTemperatureWait,// M109
+        BedTemperature,         // M140
+        BedTemperatureWait,     // M190
+        FanOn,                  // M106
+        FanOff,                 // M107
+        Acceleration,           // M204
+        RetractSettings,        // M207, M208
+        SpeedFactor,            // M220
+        ExtrudeFactor           // M221
+    };
+    
+    inline bool isMove(Command c) { return c >= Linear && c <= Recover; }
+    
+    // Marlin behaviour, the other dialects hide the members they differ in
+    struct Marlin {
+        static QString normalize(const QString &command);
+        static bool hasParameters(const QString &code);
+        static Command command(const GCodeLine &line);
+        
+        // G91 makes the extruder relative too
+        static bool extrusionIsAbsolute(bool extrusion, bool positioning) { return extrusion && positioning; }
+        static void updateAcceleration(const GCodeLine &line, GMoveModifiers *mods);
+        static void updateRetraction(const GCodeLine &line, GMoveModifiers *mods);
+        static float defaultRetractLength() { return 3.0f; }
+    };
+    
+    struct RepRapFirmware : public Marlin {
+        static QString normalize(const QString &command);
+        static bool hasParameters(const QString &code);
+        static Command command(const GCodeLine &line);
+        
+        // The extruder mode is set with M82/M83 only
+        static bool extrusionIsAbsolute(bool extrusion, bool /*positioning*/) { return extrusion; }
+        static void updateAcceleration(const GCodeLine &line, GMoveModifiers *mods);
+        static float defaultRetractLength() { return 0.0f; }
+    };
+    
+    struct Klipper : public Marlin {
+        static QString normalize(const QString &command);
+        static bool hasParameters(const QString &code);
+        static Command command(const GCodeLine &line);
+        
+        static void updateAcceleration(const GCodeLine &line, GMoveModifiers *mods);
+        static void updateRetraction(const GCodeLine &line, GMoveModifiers *mods);
+        static float defaultRetractLength() { return 0.0f; }
+        
+        static bool isExtended(const QString &code); // SET_RETRACTION, PRINT_START, etc.
+    };
+}
+
+#endif // GDIALECT_H
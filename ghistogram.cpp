@@ -0,0 +1,80 @@
+#include "ghistogram.h"
+
+#include <limits>
+
+GHistogram::GHistogram(double min, double max, int bins)
+    : mMin(min),
+      mMax(max > min ? max : min + 1.0),
+      mBins(qMax(bins, 1), 0)
+{
+    mScale = mBins.size() / (mMax - mMin);
+    clear();
+}
+
+void GHistogram::add(double value)
+{
+    if (value < mMin) {
+        ++mUnderflow;
+    } else if (value >= mMax) {
+        ++mOverflow;
+    } else {
+        ++mBins[qMin(int((value - mMin) * mScale), mBins.size() - 1)];
+    }
+    
+    ++mCount;
+    mSum += value;
+    mMinValue = qMin(mMinValue, value);
+    mMaxValue = qMax(mMaxValue, value);
+}
+
+void GHistogram::merge(const GHistogram &other)
+{
+    Q_ASSERT(other.mMin == mMin && other.mMax == mMax && other.mBins.size() == mBins.size());
+    for (int i = 0; i < mBins.size(); ++i) {
+        mBins[i] += other.mBins.at(i);
+    }
+    mUnderflow += other.mUnderflow;
+    mOverflow += other.mOverflow;
+    
+    mCount += other.mCount;
+    mSum += other.mSum;
+    mMinValue = qMin(mMinValue, other.mMinValue);
+    mMaxValue = qMax(mMaxValue, other.mMaxValue);
+}
+
+void GHistogram::clear()
+{
+    mBins.fill(0);
+    mUnderflow = 0;
+    mOverflow = 0;
+    
+    mCount = 0;
+    mSum = 0.0;
+    mMinValue = std::numeric_limits<double>::max();
+    mMaxValue = -std::numeric_limits<double>::max();
+}
+
+double GHistogram::percentile(double p) const
+{
+    if (mCount == 0) {
+        return 0.0;
+    }
+    
+    // The rank of the value, out of range values are at the observed extremes
+    double rank = qBound(0.0, p, 100.0) / 100.0 * mCount;
+    if (rank <= mUnderflow) {
+        return mMinValue;
+    }
+    
+    double seen = mUnderflow;
+    for (int i = 0; i < mBins.size(); ++i) {
+        int n = mBins.at(i);
+        if (n > 0 && rank <= seen + n) {
+            double value = mMin + (i + (rank - seen) / n) / mScale;
+            return qBound(mMinValue, value, mMaxValue);
+        }
+        seen += n;
+    }
+    
+    return mMaxValue;
+}
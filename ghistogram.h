@@ -0,0 +1,47 @@
+#ifndef GHISTOGRAM_H
+#define GHISTOGRAM_H
+
+#include <QVector>
+
+// Histogram with equal bins over [min, max), values outside go to the
+// underflow and overflow counts. Histograms with the same bins can be merged.
+// Percentiles are interpolated inside the bins.
+class GHistogram
+{
+public:
+    GHistogram(double min = 0.0, double max = 1.0, int bins = 100);
+    
+    void add(double value);
+    void merge(const GHistogram &other);
+    void clear();
+    
+    int count() const { return mCount; }
+    double sum() const { return mSum; }
+    double mean() const { return mCount > 0 ? mSum / mCount : 0.0; }
+    double minValue() const { return mMinValue; } // Of the values added
+    double maxValue() const { return mMaxValue; }
+    double percentile(double p) const; // p in [0, 100]
+    
+    double min() const { return mMin; }
+    double max() const { return mMax; }
+    int binsCount() const { return mBins.size(); }
+    int bin(int i) const { return mBins.at(i); }
+    double binWidth() const { return (mMax - mMin) / mBins.size(); }
+    int underflow() const { return mUnderflow; }
+    int overflow() const { return mOverflow; }
+
+private:
+    double mMin;
+    double mMax;
+    double mScale; // Bins per unit
+    QVector<int> mBins;
+    int mUnderflow;
+    int mOverflow;
+    
+    int mCount;
+    double mSum;
+    double mMinValue;
+    double mMaxValue;
+};
+
+#endif // GHISTOGRAM_H
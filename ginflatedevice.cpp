@@ -0,0 +1,239 @@
+#include "ginflatedevice.h"
+
+#include <QtConcurrent>
+#include <cstring>
+#include <zlib.h>
+
+GInflateDevice::GInflateDevice(QIODevice *source, QObject *parent)
+    : QIODevice(parent),
+      mSource(source),
+      mFinished(false),
+      mCanceled(false),
+      mChunkPos(0)
+{
+}
+
+GInflateDevice::~GInflateDevice()
+{
+    close();
+}
+
+GInflateDevice::Format GInflateDevice::format(const QByteArray &header)
+{
+    const uchar *h = reinterpret_cast<const uchar*>(header.constData());
+    if (header.size() >= 2 && h[0] == 0x1f && h[1] == 0x8b) {
+        return Gzip;
+    }
+    if (header.size() >= 4 && h[0] == 0x28 && h[1] == 0xb5 && h[2] == 0x2f && h[3] == 0xfd) {
+        return Zstd;
+    }
+    return Plain;
+}
+
+bool GInflateDevice::open(QIODevice::OpenMode mode)
+{
+    if ((mode & WriteOnly) || !mSource->isReadable()) {
+        return false;
+    }
+    
+    mChunks.clear();
+    mChunk.clear();
+    mChunkPos = 0;
+    mFinished = false;
+    mCanceled = false;
+    mError.clear();
+    
+    QIODevice::open(mode | Unbuffered);
+    mInflating = QtConcurrent::run([this]() {
+        inflateSource();
+    });
+    return true;
+}
+
+void GInflateDevice::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    
+    mMutex.lock();
+    mCanceled = true;
+    mDrained.wakeAll();
+    mMutex.unlock();
+    mInflating.waitForFinished();
+    
+    QIODevice::close();
+}
+
+// Blocks until the inflating thread has a chunk or has finished
+bool GInflateDevice::atEnd() const
+{
+    return !waitForChunk();
+}
+
+qint64 GInflateDevice::bytesAvailable() const
+{
+    QMutexLocker locker(&mMutex);
+    qint64 size = mChunk.size() - mChunkPos;
+    foreach (const QByteArray &chunk, mChunks) {
+        size += chunk.size();
+    }
+    return size + QIODevice::bytesAvailable();
+}
+
+bool GInflateDevice::hasError() const
+{
+    QMutexLocker locker(&mMutex);
+    return !mError.isEmpty();
+}
+
+qint64 GInflateDevice::readData(char *data, qint64 maxSize)
+{
+    if (!waitForChunk()) {
+        QMutexLocker locker(&mMutex);
+        if (!mError.isEmpty()) {
+            setErrorString(mError);
+            return -1;
+        }
+        return 0;
+    }
+    
+    qint64 size = qMin(maxSize, qint64(mChunk.size() - mChunkPos));
+    memcpy(data, mChunk.constData() + mChunkPos, size);
+    mChunkPos += size;
+    return size;
+}
+
+qint64 GInflateDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+// Takes the next chunk from the queue when the current one is consumed
+bool GInflateDevice::waitForChunk() const
+{
+    if (mChunkPos < mChunk.size()) {
+        return true;
+    }
+    
+    QMutexLocker locker(&mMutex);
+    while (mChunks.isEmpty() && !mFinished) {
+        mFilled.wait(&mMutex);
+    }
+    if (mChunks.isEmpty()) {
+        return false;
+    }
+    
+    mChunk = mChunks.takeFirst();
+    mChunkPos = 0;
+    mDrained.wakeAll();
+    return true;
+}
+
+// Runs on the pool. Concatenated gzip members are read as one stream, the
+// bytes after a member that do not start with the gzip magic are ignored.
+void GInflateDevice::inflateSource()
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) { // Gzip header
+        finish(QString("Cannot initialize the decompression"));
+        return;
+    }
+    
+    QByteArray in(ChunkSize, 0);
+    QByteArray out;
+    bool ended = false;
+    bool full = false; // Inflated output may be pending without input
+    QString error;
+    
+    // At least the two bytes of the magic in the input, if the source has them
+    auto nextMember = [this, &stream, &in, &error]() {
+        if (stream.avail_in < 2) {
+            int left = int(stream.avail_in);
+            if (left > 0) {
+                in[0] = char(*stream.next_in);
+            }
+            qint64 n = mSource->read(in.data() + left, in.size() - left);
+            if (n < 0) {
+                error = mSource->errorString();
+                n = 0;
+            }
+            stream.next_in = reinterpret_cast<Bytef*>(in.data());
+            stream.avail_in = uInt(left + n);
+        }
+        return stream.avail_in >= 2 && stream.next_in[0] == 0x1f && stream.next_in[1] == 0x8b;
+    };
+    
+    for (;;) {
+        if (stream.avail_in == 0 && !full) {
+            qint64 n = mSource->read(in.data(), in.size());
+            if (n < 0) {
+                error = mSource->errorString();
+                break;
+            }
+            if (n == 0) {
+                if (!ended) {
+                    error = QString("Unexpected end of the compressed data");
+                }
+                break;
+            }
+            stream.next_in = reinterpret_cast<Bytef*>(in.data());
+            stream.avail_in = uInt(n);
+        }
+        
+        out.resize(ChunkSize);
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = uInt(out.size());
+        
+        int result = inflate(&stream, Z_NO_FLUSH);
+        bool last = false;
+        if (result == Z_STREAM_END) {
+            ended = true;
+            last = !nextMember();
+            if (!last) {
+                inflateReset(&stream);
+            }
+        } else if (result == Z_OK) {
+            ended = false;
+        } else if (result != Z_BUF_ERROR) {
+            error = stream.msg ? QString::fromLatin1(stream.msg) : QString("Corrupt compressed data");
+            break;
+        }
+        
+        full = stream.avail_out == 0;
+        out.resize(ChunkSize - stream.avail_out);
+        if ((!out.isEmpty() && !push(out)) || last) {
+            break;
+        }
+    }
+    
+    inflateEnd(&stream);
+    finish(error);
+}
+
+// Waits while the queue is full, false when the reader closed the device
+bool GInflateDevice::push(const QByteArray &chunk)
+{
+    QMutexLocker locker(&mMutex);
+    while (mChunks.size() >= ChunksCount && !mCanceled) {
+        mDrained.wait(&mMutex);
+    }
+    if (mCanceled) {
+        return false;
+    }
+    
+    mChunks.append(chunk);
+    mFilled.wakeAll();
+    return true;
+}
+
+void GInflateDevice::finish(const QString &error)
+{
+    QMutexLocker locker(&mMutex);
+    mError = mCanceled ? QString() : error;
+    mFinished = true;
+    mFilled.wakeAll();
+}
@@ -0,0 +1,70 @@
+#ifndef GINFLATEDEVICE_H
+#define GINFLATEDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+
+// Sequential device reading the decompressed data of a gzip source.
+// The source is inflated on a pool thread into a bounded queue
+// of chunks, so the reader works on one chunk while the next ones are
+// inflated and at most ChunksCount chunks are held at once.
+class GInflateDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    enum Format {
+        Plain = 0,
+        Gzip,
+        Zstd
+    };
+    
+    enum {
+        ChunkSize = 256 * 1024,
+        ChunksCount = 4
+    };
+    
+    explicit GInflateDevice(QIODevice *source, QObject *parent = 0);
+    ~GInflateDevice();
+    
+    static Format format(const QByteArray &header); // From the first 4 bytes
+    
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const { return true; }
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    
+    bool hasError() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    void inflateSource();
+    bool push(const QByteArray &chunk);
+    void finish(const QString &error);
+    bool waitForChunk() const;
+    
+    QIODevice *mSource;
+    QFuture<void> mInflating;
+    
+    // Shared with the inflating thread
+    mutable QMutex mMutex;
+    mutable QWaitCondition mFilled;
+    mutable QWaitCondition mDrained;
+    mutable QList<QByteArray> mChunks;
+    bool mFinished;
+    bool mCanceled;
+    QString mError;
+    
+    // Reader side
+    mutable QByteArray mChunk;
+    mutable int mChunkPos;
+};
+
+#endif // GINFLATEDEVICE_H
@@ -0,0 +1,61 @@
+#include "glinepool.h"
+
+GLinePool::GLinePool()
+{
+    clear();
+}
+
+void GLinePool::finish()
+{
+    mLines.clear();
+    mCommands.clear();
+    mComments.clear();
+}
+
+void GLinePool::clear()
+{
+    finish();
+    mLinesCount = 0;
+    mSharedLines = 0;
+    mSharedCommands = 0;
+    mSharedComments = 0;
+    mCharsRead = 0;
+    mCharsStored = 0;
+}
+
+double GLinePool::ratio() const
+{
+    return mCharsStored > 0 ? double(mCharsRead) / mCharsStored : 1.0;
+}
+
+// The fields follow from the command, so they are shared with it
+void GLinePool::share(GCodeLine *line)
+{
+    mCharsRead += line->mLine.size() + line->mCommand.size() + line->mComment.size();
+    mCharsStored += line->mLine.size();
+    
+    if (!line->mCommand.isEmpty()) {
+        const GCodeLine *seen = mCommands.value(line->mCommand);
+        if (seen) {
+            ++mSharedCommands;
+            line->mCommand = seen->mCommand;
+            line->mFields = seen->mFields;
+            line->mKeys = seen->mKeys;
+            line->mParameters = seen->mParameters;
+        } else {
+            mCommands.insert(line->mCommand, line);
+            mCharsStored += line->mCommand.size();
+        }
+    }
+    
+    if (!line->mComment.isEmpty()) {
+        QSet<QString>::const_iterator i = mComments.constFind(line->mComment);
+        if (i != mComments.constEnd()) {
+            ++mSharedComments;
+            line->mComment = *i;
+        } else {
+            mComments.insert(line->mComment);
+            mCharsStored += line->mComment.size();
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef GLINEPOOL_H
+#define GLINEPOOL_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include "gcodeline.h"
+
+// Creates the lines of a read so that repeated text is stored once.
+// A line seen before is a copy of the first one, and lines with the same
+// command or comment share it with its parsed fields. The strings are
+// implicitly shared, so the tables can be dropped after the read.
+class GLinePool
+{
+public:
+    GLinePool();
+    
+    template <class Dialect>
+    GCodeLine* create(const QString &text, const Dialect &dialect);
+    void finish(); // Drops the tables, keeps the counts
+    void clear();
+    
+    int linesCount() const { return mLinesCount; }
+    int sharedLines() const { return mSharedLines; } // Copies of a whole line
+    int sharedCommands() const { return mSharedCommands; }
+    int sharedComments() const { return mSharedComments; }
+    double ratio() const; // Characters of the lines per character stored
+
+private:
+    void share(GCodeLine *line);
+    
+    QHash<QString, const GCodeLine*> mLines;
+    QHash<QString, const GCodeLine*> mCommands;
+    QSet<QString> mComments;
+    
+    int mLinesCount;
+    int mSharedLines;
+    int mSharedCommands;
+    int mSharedComments;
+    qint64 mCharsRead;
+    qint64 mCharsStored;
+};
+
+template <class Dialect>
+GCodeLine* GLinePool::create(const QString &text, const Dialect &dialect)
+{
+    ++mLinesCount;
+    
+    const GCodeLine *seen = mLines.value(text);
+    if (seen) {
+        ++mSharedLines;
+        mCharsRead += text.size() + seen->mCommand.size() + seen->mComment.size();
+        return new GCodeLine(*seen);
+    }
+    
+    GCodeLine *line = new GCodeLine(text, dialect);
+    share(line);
+    mLines.insert(line->mLine, line);
+    return line;
+}
+
+#endif // GLINEPOOL_H
@@ -0,0 +1,275 @@
+#include "gmeatpack.h"
+
+#include "gcode.h"
+
+namespace {
+    const uchar Signal = 0xff;
+    const uchar EnablePacking = 0xfb;
+    const uchar DisablePacking = 0xfa;
+    const uchar ResetAll = 0xf9;
+    const uchar EnableNoSpaces = 0xf7;
+    const uchar DisableNoSpaces = 0xf6;
+    const uchar Escape = 0x0f;
+    
+    int packed(char c, bool noSpaces)
+    {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        switch (c) {
+        case '.': return 10;
+        case ' ': return noSpaces ? Escape : 11;
+        case 'E': return noSpaces ? 11 : Escape;
+        case '\n': return 12;
+        case 'G': return 13;
+        case 'X': return 14;
+        default: return Escape;
+        }
+    }
+    
+    char unpacked(int code, bool noSpaces)
+    {
+        static const char chars[] = "0123456789. \nGX";
+        return code == 11 && noSpaces ? 'E' : chars[code];
+    }
+    
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+    
+    // Parameter letters after the code are written without the space in the no spaces mode
+    bool isParameter(char c)
+    {
+        return c >= 'A' && c <= 'Z';
+    }
+    
+    // G and a number, the extended commands like GET_POSITION keep their spaces
+    bool isGLine(const QByteArray &line)
+    {
+        return line.size() > 1 && line.at(0) == 'G' && isDigit(line.at(1));
+    }
+}
+
+GMeatPack::GMeatPack(bool noSpaces)
+    : mNoSpaces(noSpaces),
+      mTextBytes(0),
+      mPackedBytes(0)
+{
+    reset();
+}
+
+QByteArray GMeatPack::start() const
+{
+    QByteArray signal;
+    signal.append(char(Signal));
+    signal.append(char(Signal));
+    signal.append(char(EnablePacking));
+    signal.append(char(Signal));
+    signal.append(char(Signal));
+    signal.append(char(mNoSpaces ? EnableNoSpaces : DisableNoSpaces));
+    return signal;
+}
+
+QByteArray GMeatPack::stop() const
+{
+    QByteArray signal;
+    signal.append(char(Signal));
+    signal.append(char(Signal));
+    signal.append(char(DisablePacking));
+    return signal;
+}
+
+// A missing last newline is added
+void GMeatPack::encode(const QByteArray &text, QByteArray *out)
+{
+    int from = out->size();
+    out->reserve(from + text.size() * 2 / 3 + 1);
+    
+    for (int begin = 0; begin < text.size(); ) {
+        int end = text.indexOf('\n', begin) + 1;
+        if (end == 0) {
+            end = text.size();
+        }
+        
+        QByteArray line = text.mid(begin, end - begin);
+        if (mNoSpaces && isGLine(line)) {
+            // Only the spaces the decoder puts back are dropped
+            int comment = line.indexOf(';');
+            int size = 0;
+            for (int i = 0; i < line.size(); ++i) {
+                bool dropped = line.at(i) == ' ' && (comment < 0 || i < comment)
+                        && i + 1 < line.size() && isParameter(line.at(i + 1));
+                if (!dropped) {
+                    line[size++] = line.at(i);
+                }
+            }
+            line.truncate(size);
+        }
+        if (!line.endsWith('\n')) {
+            line.append('\n');
+        }
+        
+        packLine(line, out);
+        begin = end;
+    }
+    
+    mTextBytes += text.size();
+    mPackedBytes += out->size() - from;
+}
+
+QByteArray GMeatPack::encode(const GCode *gcode, int firstLine, int lastLine, bool comments)
+{
+    Q_ASSERT(firstLine >= 0 && lastLine < gcode->linesCount());
+    
+    QByteArray text;
+    for (int l = firstLine; l <= lastLine; ++l) {
+        QString line = comments ? gcode->text(l).trimmed() : gcode->command(l);
+        if (!line.isEmpty()) {
+            text.append(line.toUtf8());
+            text.append('\n');
+        }
+    }
+    
+    QByteArray out = start();
+    encode(text, &out);
+    return out;
+}
+
+void GMeatPack::clearStatistics()
+{
+    mTextBytes = 0;
+    mPackedBytes = 0;
+}
+
+void GMeatPack::reset()
+{
+    mPacking = false;
+    mDecodeNoSpaces = false;
+    mSignalBytes = 0;
+    mFullChars = 0;
+    mPending = 0;
+    mGLine = false;
+    mCode = false;
+    mComment = false;
+    mLineStart = true;
+    mLast = 0;
+}
+
+void GMeatPack::decode(const QByteArray &data, QByteArray *out)
+{
+    out->reserve(out->size() + data.size() * 3 / 2);
+    
+    const uchar *in = reinterpret_cast<const uchar*>(data.constData());
+    for (int i = 0; i < data.size(); ++i) {
+        uchar c = in[i];
+        if (mSignalBytes == 2) {
+            switch (c) {
+            case EnablePacking: mPacking = true; break;
+            case DisablePacking: mPacking = false; break;
+            case ResetAll: mPacking = false; break;
+            case EnableNoSpaces: mDecodeNoSpaces = true; break;
+            case DisableNoSpaces: mDecodeNoSpaces = false; break;
+            default: break;
+            }
+            mSignalBytes = 0;
+        
+        } else if (c == Signal) {
+            ++mSignalBytes;
+        
+        } else {
+            if (mSignalBytes > 0) {
+                unpack(Signal, out);
+                mSignalBytes = 0;
+            }
+            unpack(c, out);
+        }
+    }
+}
+
+// The first character of a byte goes in the low bits, a newline there ends the byte
+void GMeatPack::packLine(const QByteArray &line, QByteArray *out) const
+{
+    int i = 0;
+    while (i < line.size()) {
+        char c1 = line.at(i++);
+        int k1 = packed(c1, mNoSpaces);
+        if (c1 == '\n') {
+            out->append(char(k1));
+            continue;
+        }
+        
+        char c2 = line.at(i++);
+        int k2 = packed(c2, mNoSpaces);
+        out->append(char(k1 | k2 << 4));
+        if (k1 == Escape) {
+            out->append(c1);
+        }
+        if (k2 == Escape) {
+            out->append(c2);
+        }
+    }
+}
+
+// The line state is kept here, the output may be a fresh buffer for every chunk
+void GMeatPack::emitChar(char c, QByteArray *out)
+{
+    if (c == '\n') {
+        mGLine = false;
+        mCode = false;
+        mComment = false;
+    } else if (mLineStart) {
+        mGLine = c == 'G';
+        mCode = mGLine;
+    } else if (c == ';') {
+        mCode = false;
+        mComment = true;
+    } else if (mCode && (isDigit(c) || (c == '.' && mLast != 'G'))) {
+        // Still in the code, like G29.1
+    } else if (mCode && mLast == 'G') {
+        mGLine = false;
+        mCode = false;
+    } else {
+        mCode = false;
+        if (mDecodeNoSpaces && mGLine && !mComment && isParameter(c) && mLast != ' ') {
+            out->append(' ');
+        }
+    }
+    out->append(c);
+    mLineStart = c == '\n';
+    mLast = c;
+}
+
+void GMeatPack::unpack(uchar c, QByteArray *out)
+{
+    if (!mPacking) {
+        emitChar(char(c), out);
+    
+    } else if (mFullChars > 0) {
+        emitChar(char(c), out);
+        if (mPending) {
+            emitChar(mPending, out);
+            mPending = 0;
+        }
+        --mFullChars;
+    
+    } else if ((c & Escape) == Escape) {
+        ++mFullChars;
+        if ((c >> 4) == Escape) {
+            ++mFullChars;
+        } else {
+            mPending = unpacked(c >> 4, mDecodeNoSpaces);
+        }
+    
+    } else {
+        char first = unpacked(c & Escape, mDecodeNoSpaces);
+        emitChar(first, out);
+        if (first != '\n') {
+            if ((c >> 4) == Escape) {
+                ++mFullChars;
+            } else {
+                emitChar(unpacked(c >> 4, mDecodeNoSpaces), out);
+            }
+        }
+    }
+}
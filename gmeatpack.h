@@ -0,0 +1,58 @@
+#ifndef GMEATPACK_H
+#define GMEATPACK_H
+
+#include <QByteArray>
+
+class GCode;
+
+// MeatPack, the G-code packing Marlin decodes on the serial line and binary
+// G-code uses in its blocks. The digits, '.', ' ' (or 'E' in the no spaces
+// mode), '\n', 'G' and 'X' take 4 bits, two to a byte; other characters
+// follow the byte in full. 0xff 0xff and a command byte switch the modes.
+class GMeatPack
+{
+public:
+    explicit GMeatPack(bool noSpaces = false);
+    
+    bool noSpaces() const { return mNoSpaces; } // Of the encoder
+    
+    // Encoder. Lines end with '\n', spaces in front of the parameters of the G lines
+    // are dropped in the no spaces mode.
+    QByteArray start() const; // Enables the packing and the spaces mode
+    QByteArray stop() const;
+    void encode(const QByteArray &text, QByteArray *out);
+    QByteArray encode(const GCode *gcode, int firstLine, int lastLine, bool comments = false); // With start(), without the empty lines
+    
+    qint64 textBytes() const { return mTextBytes; }
+    qint64 packedBytes() const { return mPackedBytes; }
+    double ratio() const { return mTextBytes > 0 ? double(mPackedBytes) / mTextBytes : 1.0; }
+    void clearStatistics();
+    
+    // Decoder, keeps its state between the calls. Spaces are put back in front
+    // of the letters after the code of the G lines in the no spaces mode.
+    void reset();
+    void decode(const QByteArray &data, QByteArray *out);
+
+private:
+    void packLine(const QByteArray &line, QByteArray *out) const;
+    void emitChar(char c, QByteArray *out);
+    void unpack(uchar c, QByteArray *out);
+    
+    bool mNoSpaces;
+    qint64 mTextBytes;
+    qint64 mPackedBytes;
+    
+    // Decoder
+    bool mPacking;
+    bool mDecodeNoSpaces;
+    int mSignalBytes; // Consecutive 0xff
+    int mFullChars;   // Full characters to come
+    char mPending;    // Packed second character waiting for a full first one
+    bool mGLine;
+    bool mCode; // In the code word of a G line
+    bool mComment;
+    bool mLineStart;
+    char mLast; // The last character decoded
+};
+
+#endif // GMEATPACK_H
@@ -33,7 +33,7 @@ GMove::GMove()
 {
 }
 
-GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers &mods)
+GMove::GMove(const GCodeLine &line, GDialect::Command command, const GMove &previous, const GMoveModifiers &mods, const GMoveModifiers &previousMods)
     : mX(0.0),
       mY(0.0),
       mZ(0.0),
@@ -43,7 +43,6 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
       mE(0.0),
       mF(0.0),
       mS(0),
-      mMods(mods),
       mDE(0.0),
       mET(0.0),
       mLen(0.0),
@@ -54,21 +53,27 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
       mArcDir(Undefined),
       mType(None)
 {
-    QString code = line.code();
-    if (!testCode(code)) {
+    if (!GDialect::isMove(command)) {
+        return;
+    }
+    
+    if (command == GDialect::Retract || command == GDialect::Recover) {
+        setRetraction(command, previous, mods);
         return;
     }
     
     bool ok = false;
-    if (code == "G1" || code == "G0" || code == "G2" || code == "G3") {
+    if (command == GDialect::Linear || command == GDialect::ArcCW || command == GDialect::ArcCCW) {
+        bool absolute = mods.positioningIsAbsolute;
+        
         double p = line.parameter('X', &ok);
-        mX = ok ? p : previous.X();
+        mX = ok ? (absolute ? p : previous.X() + p) : previous.X();
         
         p = line.parameter('Y', &ok);
-        mY = ok ? p : previous.Y();
+        mY = ok ? (absolute ? p : previous.Y() + p) : previous.Y();
         
         p = line.parameter('Z', &ok);
-        mZ = ok ? p : previous.Z();
+        mZ = ok ? (absolute ? p : previous.Z() + p) : previous.Z();
         
         p = line.parameter('I', &ok);
         mI = ok ? p : 0.0;
@@ -77,12 +82,12 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
         mJ = ok ? p : 0.0;
         
         p = line.parameter('E', &ok);
-        mE = ok ? p : (mMods.extrusionIsAbsolute && previous.E() != mMods.extruderShift ? previous.E() : 0.0);
+        mE = ok ? p : (mods.extrusionIsAbsolute && previous.E() != mods.extruderShift ? previous.E() : 0.0);
         if (ok) {
             mE = p;
         } else {
-            if (mMods.extrusionIsAbsolute) {
-                double shiftDiff = mMods.extruderShift - previous.mMods.extruderShift;
+            if (mods.extrusionIsAbsolute) {
+                double shiftDiff = mods.extruderShift - previousMods.extruderShift;
                 mE = previous.E() - (qFuzzyCompare(shiftDiff + 1, 1.0) ? 0.0 : shiftDiff);
                 if (qFuzzyCompare(mE + 1, 1.0)) {
                     mE = 0.0;
@@ -95,11 +100,11 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
         p = line.parameter('F', &ok);
         mF = ok ? p : previous.F();
         
-        if (code == "G1" || code == "G0") {
+        if (command == GDialect::Linear) {
             mLen = qSqrt(distQuad(mX, mY, mZ, previous.X(), previous.Y(), previous.Z()));
             
-        } else if (code == "G2" || code == "G3") {
-            mArcDir = (code == "G2") ? CW : CCW;
+        } else {
+            mArcDir = (command == GDialect::ArcCW) ? CW : CCW;
             mCX = previous.X() + mI;
             mCY = previous.Y() + mJ;
             double r2 = distQuad(mX, mY, 0.0, mCX, mCY, 0.0); // radius squared
@@ -114,7 +119,7 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
             mLen = theta * mR;
         }
         
-    } else if (code == "G28") {
+    } else if (command == GDialect::Home) {
         QList<char> pars = line.parameters();
         if (!pars.isEmpty()) {
             mX = pars.contains('X') ? 0.0 :previous.X();
@@ -127,8 +132,8 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
         mLen = 0.0;
     }
     
-    if (mMods.extrusionIsAbsolute) {
-        double shiftDiff = mMods.extruderShift - previous.mMods.extruderShift;
+    if (mods.extrusionIsAbsolute) {
+        double shiftDiff = mods.extruderShift - previousMods.extruderShift;
         mET = shiftDiff + previous.ET() + (mE - previous.E());
         
         if (qFuzzyCompare(mE, previous.E())) {
@@ -142,12 +147,12 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
                 mDE = 0.0;
             }
             
-            mDEe = mDE * mMods.extrudeFactor;
+            mDEe = mDE * mods.extrudeFactor;
             if (qFuzzyCompare(mDEe + 1, 1.0)) {
                 mDEe = 0.0;
             }
             
-//            double shiftDiff = mMods.extruderShift - previous.mMods.extruderShift;
+//            double shiftDiff = mods.extruderShift - previousMods.extruderShift;
 //            if (qFuzzyCompare(shiftDiff + 1, 1.0)) {
 //                shiftDiff = 0.0;
 //            }
@@ -166,7 +171,7 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
             
         } else {
             mDE = mE;
-            mDEe = mDE * mMods.extrudeFactor;
+            mDEe = mDE * mods.extrudeFactor;
             mEe = mDEe;
         }
     
@@ -182,12 +187,23 @@ GMove::GMove(const GCodeLine &line, const GMove &previous, const GMoveModifiers
     }
 }
 
-bool GMove::testCode(const QString &code)
+// Firmware retraction moves the filament by the configured length and
+// leaves the logical E position untouched
+void GMove::setRetraction(GDialect::Command command, const GMove &previous, const GMoveModifiers &mods)
 {
-    if (code == "G1" || code == "G0" || code == "G2" || code == "G3" || code == "G28") {
-        return true;
-    }
-    return false;
+    mX = previous.X();
+    mY = previous.Y();
+    mZ = previous.Z();
+    mF = previous.F();
+    mE = mods.extrusionIsAbsolute ? previous.E() : 0.0;
+    
+    mDE = command == GDialect::Retract ? -mods.retractLength : mods.retractLength + mods.recoverExtraLength;
+    mDEe = mDE * mods.extrudeFactor;
+    mET = previous.ET() + mDE;
+    mEe = mods.extrusionIsAbsolute ? previous.Ee() : mDEe;
+    mETe = previous.ETe() + mDEe;
+    
+    mType = mDEe == 0.0 ? None : (mDEe > 0 ? DestringPrime : DestringSuck);
 }
 
 inline double distQuad(double x1, double y1, double z1, double x2, double y2, double z2)
@@ -5,6 +5,7 @@
 #include <QStringList>
 
 #include "gcodelib.h"
+#include "gdialect.h"
 
 class GCodeLine;
 
@@ -14,17 +15,25 @@ struct GMoveModifiers {
           speedFactor(1.0f), 
           extrudeFactor(1.0f),
           extrusionIsAbsolute(true),
+          positioningIsAbsolute(true),
           bedTemp(0.0f),
           extTemp(0.0f),
-          fanSpeed(0) {}
+          fanSpeed(0),
+          acceleration(0.0f),
+          retractLength(0.0f),
+          recoverExtraLength(0.0f) {}
     
     double extruderShift;
     float speedFactor;
     float extrudeFactor;
-    bool extrusionIsAbsolute;
+    bool extrusionIsAbsolute; // Effective extruder mode, including G91 where the firmware applies it
+    bool positioningIsAbsolute;
     float bedTemp;
     float extTemp;
     int fanSpeed;
+    float acceleration;
+    float retractLength; // Firmware retract
+    float recoverExtraLength;
 };
 
 class GMove
@@ -70,23 +79,17 @@ public:
     double dE() const { return mDE; } // Delta E value
     double ET() const { return mET; } // Total extrusion value
     double distance() const { return mLen; }
-    float bedT() const { return mMods.bedTemp; }
-    float extT() const { return mMods.extTemp; }
-    float fanSpeed() const { return mMods.fanSpeed / 2.55f; }
     
-    float Ff() const { return mMods.speedFactor; }
-    float Ef() const { return mMods.extrudeFactor; }
-
-    double Fe() const { return mF * mMods.speedFactor; } // Feedrate effective value
     double Ee() const { return mEe; } // Extrusion effective value
     double ETe() const { return mETe; } // Total extrusion effective value
     double dEe() const { return mDEe; } // Delta E effective value
     double flowE() const { return mFlowE; } // Effective flow (dE / distance)
 
 private:
-    GMove(const GCodeLine &line, const GMove &previous = GMove(), const GMoveModifiers &mods = GMoveModifiers());
+    GMove(const GCodeLine &line, GDialect::Command command, const GMove &previous = GMove(), 
+          const GMoveModifiers &mods = GMoveModifiers(), const GMoveModifiers &previousMods = GMoveModifiers());
     
-    static bool testCode(const QString &code);
+    void setRetraction(GDialect::Command command, const GMove &previous, const GMoveModifiers &mods);
     
 private:
     double mX;
@@ -101,8 +104,6 @@ private:
     double mF;
     int mS;
     
-    GMoveModifiers mMods;
-    
     double mDE;
     double mET;
     double mLen;
@@ -0,0 +1,20 @@
+#ifndef GMOVEOBSERVER_H
+#define GMOVEOBSERVER_H
+
+#include "gmove.h"
+
+class GCode;
+
+// Receives the moves while GCode parses a stream, see GCode::addObserver().
+// Called in the reading thread, in move order.
+class GMoveObserver
+{
+public:
+    virtual ~GMoveObserver() {}
+    
+    virtual void beginRead(const GCode *gcode) { Q_UNUSED(gcode); }
+    virtual void move(int m, int line, const GMove &move, const GMoveModifiers &mods) = 0;
+    virtual void endRead(const GCode *gcode) { Q_UNUSED(gcode); } // After the data is complete
+};
+
+#endif // GMOVEOBSERVER_H
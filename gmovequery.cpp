@@ -0,0 +1,219 @@
+#include "gmovequery.h"
+
+#include "gcode.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+
+static const int ChunkWords = 64;
+static const int ChunkSize = ChunkWords * 64; // Moves evaluated by one task
+
+// Tests count values into count bits. The inner loop has no branches,
+// so the compiler can vectorize it.
+template <class Test>
+static void testColumn(const float *values, int count, quint64 *words, Test test)
+{
+    for (int w = 0; w * 64 < count; ++w) {
+        const float *v = values + w * 64;
+        int n = qMin(64, count - w * 64);
+        quint64 bits = 0;
+        for (int i = 0; i < n; ++i) {
+            bits |= quint64(test(v[i])) << i;
+        }
+        words[w] = bits;
+    }
+}
+
+GMoveQuery::GMoveQuery()
+{
+    mProgram.append(Node(True));
+}
+
+GMoveQuery::GMoveQuery(const GMoveQuery::Node &leaf)
+{
+    mProgram.append(leaf);
+}
+
+GMoveQuery GMoveQuery::less(GMoveQuery::Column column, double value)
+{
+    return GMoveQuery(Node(Less, column, value));
+}
+
+GMoveQuery GMoveQuery::lessEqual(GMoveQuery::Column column, double value)
+{
+    return GMoveQuery(Node(LessEqual, column, value));
+}
+
+GMoveQuery GMoveQuery::greater(GMoveQuery::Column column, double value)
+{
+    return GMoveQuery(Node(Greater, column, value));
+}
+
+GMoveQuery GMoveQuery::greaterEqual(GMoveQuery::Column column, double value)
+{
+    return GMoveQuery(Node(GreaterEqual, column, value));
+}
+
+GMoveQuery GMoveQuery::equal(GMoveQuery::Column column, double value)
+{
+    return between(column, value, value);
+}
+
+GMoveQuery GMoveQuery::between(GMoveQuery::Column column, double min, double max)
+{
+    return GMoveQuery(Node(Between, column, qMin(min, max), qMax(min, max)));
+}
+
+GMoveQuery GMoveQuery::moveType(GMove::MoveType type)
+{
+    return equal(MoveType, type);
+}
+
+GMoveQuery GMoveQuery::operator&&(const GMoveQuery &other) const
+{
+    return combine(other, And);
+}
+
+GMoveQuery GMoveQuery::operator||(const GMoveQuery &other) const
+{
+    return combine(other, Or);
+}
+
+GMoveQuery GMoveQuery::operator!() const
+{
+    GMoveQuery query(*this);
+    query.mProgram.append(Node(Not));
+    return query;
+}
+
+bool GMoveQuery::usesColumn(GMoveQuery::Column column) const
+{
+    foreach (const Node &node, mProgram) {
+        if (isTest(node.op) && node.column == column) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+GMoveQuery GMoveQuery::combine(const GMoveQuery &other, GMoveQuery::Operation op) const
+{
+    GMoveQuery query(*this);
+    query.mProgram += other.mProgram;
+    query.mProgram.append(Node(op));
+    return query;
+}
+
+QBitArray GMoveQuery::evaluate(const GCode *gcode) const
+{
+    int size = gcode->movesCount();
+    QBitArray result(size);
+    if (size == 0) {
+        return result;
+    }
+    
+    // Columns are built before the tasks start, the cache is not thread safe
+    QVector<const float*> columns(ColumnsCount, NULL);
+    for (int c = 0; c < ColumnsCount; ++c) {
+        if (usesColumn(Column(c))) {
+            gcode->column(Column(c));
+        }
+    }
+    for (int c = 0; c < ColumnsCount; ++c) {
+        if (usesColumn(Column(c))) {
+            columns[c] = gcode->column(Column(c)).constData();
+        }
+    }
+    
+    // Every task writes its own words
+    QVector<quint64> words((size + 63) / 64, 0);
+    quint64 *out = words.data();
+    QVector<int> chunks;
+    for (int first = 0; first < size; first += ChunkSize) {
+        chunks.append(first);
+    }
+    
+    QtConcurrent::blockingMap(chunks, [this, &columns, out, size](int first) {
+        evaluateChunk(columns.constData(), first, qMin(ChunkSize, size - first), out + first / 64);
+    });
+    
+    for (int w = 0; w < words.size(); ++w) {
+        quint64 bits = words.at(w);
+        for (int i = 0; bits != 0; ++i, bits >>= 1) {
+            if (bits & 1) {
+                result.setBit(w * 64 + i);
+            }
+        }
+    }
+    
+    return result;
+}
+
+void GMoveQuery::evaluateChunk(const float * const *columns, int firstMove, int count, quint64 *words) const
+{
+    int n = (count + 63) / 64;
+    QVector<quint64> stack(mProgram.size() * n);
+    quint64 *top = stack.data(); // The next free entry
+    
+    foreach (const Node &node, mProgram) {
+        const float *v = isTest(node.op) ? columns[node.column] + firstMove : NULL;
+        float a = node.a;
+        float b = node.b;
+        
+        switch (node.op) {
+        case True:
+            std::fill(top, top + n, ~quint64(0));
+            break;
+        
+        case Less:
+            testColumn(v, count, top, [a](float x) { return x < a; });
+            break;
+        
+        case LessEqual:
+            testColumn(v, count, top, [a](float x) { return x <= a; });
+            break;
+        
+        case Greater:
+            testColumn(v, count, top, [a](float x) { return x > a; });
+            break;
+        
+        case GreaterEqual:
+            testColumn(v, count, top, [a](float x) { return x >= a; });
+            break;
+        
+        case Between:
+            testColumn(v, count, top, [a, b](float x) { return (x >= a) & (x <= b); });
+            break;
+        
+        case And:
+            top -= n;
+            for (int w = 0; w < n; ++w) {
+                top[w - n] &= top[w];
+            }
+            continue;
+        
+        case Or:
+            top -= n;
+            for (int w = 0; w < n; ++w) {
+                top[w - n] |= top[w];
+            }
+            continue;
+        
+        case Not:
+            for (int w = 0; w < n; ++w) {
+                top[w - n] = ~top[w - n];
+            }
+            continue;
+        }
+        
+        top += n;
+    }
+    
+    std::copy(stack.constData(), stack.constData() + n, words);
+    
+    // Clear the bits past the last move
+    if (count % 64 != 0) {
+        words[n - 1] &= (quint64(1) << (count % 64)) - 1;
+    }
+}
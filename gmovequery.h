@@ -0,0 +1,89 @@
+#ifndef GMOVEQUERY_H
+#define GMOVEQUERY_H
+
+#include <QBitArray>
+#include <QVector>
+
+#include "gmove.h"
+
+class GCode;
+
+// Predicate over the move columns of a GCode. Predicates are combined
+// with &&, || and !, and evaluated over all the moves at once:
+//
+//   GMoveQuery q = GMoveQuery::moveType(GMove::Extrusion)
+//           && GMoveQuery::greater(GMoveQuery::Flow, 0.05)
+//           && GMoveQuery::between(GMoveQuery::Z, 10.0, 20.0)
+//           && GMoveQuery::less(GMoveQuery::Feedrate, 1200.0);
+//   gcode->select(gcode->movesToLines(gcode->query(q)));
+//
+// Columns are compared as floats.
+class GMoveQuery
+{
+public:
+    enum Column {
+        X = 0,
+        Y,
+        Z,
+        E,
+        Feedrate,   // Effective feedrate, see GCode::Fe()
+        Flow,       // See GCode::flow()
+        Distance,   // See GCode::distance()
+        ExtruderTemperature,
+        BedTemperature,
+        FanSpeed,   // Percent, see GCode::fanSpeed()
+        MoveType,   // GMove::MoveType value
+        ColumnsCount
+    };
+    
+    GMoveQuery(); // Matches all the moves
+    
+    static GMoveQuery less(Column column, double value);
+    static GMoveQuery lessEqual(Column column, double value);
+    static GMoveQuery greater(Column column, double value);
+    static GMoveQuery greaterEqual(Column column, double value);
+    static GMoveQuery equal(Column column, double value);
+    static GMoveQuery between(Column column, double min, double max); // Inclusive
+    static GMoveQuery moveType(GMove::MoveType type);
+    
+    GMoveQuery operator&&(const GMoveQuery &other) const;
+    GMoveQuery operator||(const GMoveQuery &other) const;
+    GMoveQuery operator!() const;
+    
+    bool usesColumn(Column column) const;
+    
+    // Bit m is set for the matching moves. Chunks of moves are evaluated on the thread pool.
+    QBitArray evaluate(const GCode *gcode) const;
+
+private:
+    enum Operation {
+        True,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Between,
+        And,
+        Or,
+        Not
+    };
+    
+    // Program in postfix order
+    struct Node {
+        Node(Operation op = True, Column column = X, float a = 0.0f, float b = 0.0f)
+            : op(op), column(column), a(a), b(b) {}
+        Operation op;
+        Column column;
+        float a;
+        float b;
+    };
+    
+    explicit GMoveQuery(const Node &leaf);
+    static bool isTest(Operation op) { return op >= Less && op <= Between; }
+    GMoveQuery combine(const GMoveQuery &other, Operation op) const;
+    void evaluateChunk(const float * const *columns, int firstMove, int count, quint64 *words) const;
+    
+    QVector<Node> mProgram;
+};
+
+#endif // GMOVEQUERY_H
@@ -1,61 +1,156 @@
 #include "gnavigator.h"
 
 #include <QDebug>
+#include <QtConcurrent>
+#include <algorithm>
 
 GNavigator::GNavigator(GCode *data, QObject *parent) 
     : QObject(parent),
       mGCode(data),
       mRootItem(NULL)
 {
-    connect(mGCode, SIGNAL(dataChanged(int, int)), this, SIGNAL(dataChanged(int,int)));
+    connect(mGCode, SIGNAL(aboutToChangeData(int,int)), this, SLOT(beginUpdateData(int,int)));
+    connect(mGCode, SIGNAL(dataChanged(int, int)), this, SLOT(updateData(int,int)));
     connect(mGCode, SIGNAL(selectionChanged(int,int)), this, SIGNAL(selectionChanged(int,int)));
     connect(mGCode, SIGNAL(visibilityChanged(int,int)), this, SIGNAL(visibilityChanged(int,int)));
     connect(mGCode, SIGNAL(beginReset()), this, SLOT(beginResetData()));
     connect(mGCode, SIGNAL(endReset()), this, SLOT(endResetData()));
+    connect(&mPrefetchWatcher, SIGNAL(finished()), this, SLOT(prefetchFinished()));
     
     setupModelData();
 }
 
 GNavigator::~GNavigator()
 {
-    delete mRootItem;
+    cancelPrefetch();
+    clearModelData();
 }
 
-GNavigatorItem* GNavigator::itemAtZ(double z)
+GNavigatorItem *GNavigator::itemAtZ(double z) const
 {
-    GNavigatorItem* item = mZMap.value(z);
-    if (item) {
-        return item;
+    int i = firstZIndex(z - Layers::zTolerance);
+    if (i < mLayerZ.size() && mLayerZ.at(i) <= z + Layers::zTolerance) {
+        return mLayerItems.at(i);
     }
     
-    for (int i = 0, lim = mRootItem->childCount(); i < lim; ++i) {
-        item = mRootItem->child(i);
-        if (qFuzzyCompare(item->info().z, z)) {
-            mZMap.insert(z, item);
-            return item;
-        }
+    return NULL;
+}
+
+GNavigatorItem *GNavigator::itemNearestZ(double z) const
+{
+    GNavigatorItem *floor = itemFloorZ(z);
+    GNavigatorItem *ceil = itemCeilZ(z);
+    if (!floor || !ceil) {
+        return floor ? floor : ceil;
     }
     
-    mZMap.insert(z, NULL);
+    return (z - floor->info().z <= ceil->info().z - z) ? floor : ceil;
+}
+
+GNavigatorItem *GNavigator::itemFloorZ(double z) const
+{
+    int i = lastZIndex(z + Layers::zTolerance) - 1;
+    if (i < 0) {
+        return NULL;
+    }
     
-    return NULL;
+    // The first layer of those with the same Z
+    return mLayerItems.at(firstZIndex(mLayerZ.at(i)));
 }
 
-GNavigatorItem *GNavigator::itemAtZ(double z) const
+GNavigatorItem *GNavigator::itemCeilZ(double z) const
 {
-    GNavigatorItem* item = mZMap.value(z);
-    if (item) {
-        return item;
+    int i = firstZIndex(z - Layers::zTolerance);
+    return i < mLayerZ.size() ? mLayerItems.at(i) : NULL;
+}
+
+QList<GNavigatorItem *> GNavigator::itemsInZRange(double minZ, double maxZ) const
+{
+    QList<GNavigatorItem*> items;
+    for (int i = firstZIndex(minZ - Layers::zTolerance), lim = lastZIndex(maxZ + Layers::zTolerance); i < lim; ++i) {
+        items.append(mLayerItems.at(i));
     }
     
-    for (int i = 0, lim = mRootItem->childCount(); i < lim; ++i) {
-        item = mRootItem->child(i);
-        if (qFuzzyCompare(item->info().z, z)) {
-            return item;
-        }
+    return items;
+}
+
+GNavigatorItem *GNavigator::itemAtLine(int line)
+{
+    QList<GNavigatorItem*> path = pathAtLine(line);
+    return path.isEmpty() ? NULL : path.last();
+}
+
+QList<GNavigatorItem *> GNavigator::pathAtLine(int line)
+{
+    QList<GNavigatorItem*> path;
+    for (GNavigatorItem *item = mRootItem->childAtLine(line); item; item = item->childAtLine(line)) {
+        fetchMore(item);
+        path.append(item);
     }
     
-    return NULL;
+    return path;
+}
+
+int GNavigator::firstZIndex(double z) const
+{
+    return int(std::lower_bound(mLayerZ.constBegin(), mLayerZ.constEnd(), z) - mLayerZ.constBegin());
+}
+
+int GNavigator::lastZIndex(double z) const
+{
+    return int(std::upper_bound(mLayerZ.constBegin(), mLayerZ.constEnd(), z) - mLayerZ.constBegin());
+}
+
+void GNavigator::buildZIndex()
+{
+    mLayerZ.clear();
+    mLayerItems.clear();
+    
+    QVector<GNavigatorItem*> layers = mLayers;
+    
+    // Stable, so the layers with equal Z keep the file order
+    std::stable_sort(layers.begin(), layers.end(), [](GNavigatorItem *a, GNavigatorItem *b) {
+        return a->info().z < b->info().z;
+    });
+    
+    mLayerZ.reserve(layers.size());
+    mLayerItems.reserve(layers.size());
+    foreach (GNavigatorItem *item, layers) {
+        mLayerZ.append(item->info().z);
+        mLayerItems.append(item);
+    }
+}
+
+Qt::CheckState GNavigator::selected(GNavigatorItem *item) const
+{
+    return testState(item, mGCode->selectedCount(item->firstLine(), item->lastLine()));
+}
+
+QVector<Qt::CheckState> GNavigator::selectedChildren(GNavigatorItem *parent) const
+{
+    QVector<Qt::CheckState> states(parent->childCount());
+    for (int i = 0; i < states.size(); ++i) {
+        GNavigatorItem *item = parent->child(i);
+        states[i] = testState(item, mGCode->selectedCount(item->firstLine(), item->lastLine()));
+    }
+    
+    return states;
+}
+
+Qt::CheckState GNavigator::visible(GNavigatorItem *item) const
+{
+    return testState(item, mGCode->visibleCount(item->firstLine(), item->lastLine()));
+}
+
+QVector<Qt::CheckState> GNavigator::visibleChildren(GNavigatorItem *parent) const
+{
+    QVector<Qt::CheckState> states(parent->childCount());
+    for (int i = 0; i < states.size(); ++i) {
+        GNavigatorItem *item = parent->child(i);
+        states[i] = testState(item, mGCode->visibleCount(item->firstLine(), item->lastLine()));
+    }
+    
+    return states;
 }
 
 void GNavigator::select(GNavigatorItem *begin, GNavigatorItem *end)
@@ -142,18 +237,220 @@ void GNavigator::toggleVisible(GNavigatorItem *begin, GNavigatorItem *end)
 
 void GNavigator::beginResetData()
 {
+    cancelPrefetch();
     emit beginReset();
 }
 
 void GNavigator::endResetData()
 {
-    delete mRootItem;
+    clearModelData();
     setupModelData();
 //    qDebug() << __PRETTY_FUNCTION__;
     emit endReset();
 }
 
-void GNavigator::calculateRouteData(int move, GNavigatorItemInfo *pRouteData)
+// The prefetch reads the moves that are about to be deleted
+void GNavigator::beginUpdateData(int top, int bottom)
+{
+    Q_UNUSED(top);
+    Q_UNUSED(bottom);
+    
+    cancelPrefetch();
+}
+
+// Rebuilds the layers overlapping the lines changed in place. The changed
+// range must cover every line whose move has changed.
+void GNavigator::updateData(int top, int bottom)
+{
+    if (!mRootItem || mLayers.isEmpty() || mRootItem->lastLine() != mGCode->linesCount() - 1) {
+        beginResetData();
+        endResetData();
+        emit dataChanged(top, bottom);
+        return;
+    }
+    
+    cancelPrefetch();
+    top = qBound(0, top, mRootItem->lastLine());
+    bottom = qBound(top, bottom, mRootItem->lastLine());
+    
+    // The previous layer too, the first move of the changed layer may now have its Z
+    int first = qMax(mRootItem->childAtLine(top)->row() - 1, 0);
+    int move = first == 0 ? 0 : mGCode->lineToMoveForward(mLayers.at(first)->firstLine());
+    double z = first == 0 ? 0.0 : mGCode->Z(move);
+    
+    // Boundary pass from the first layer until a boundary below the changed
+    // lines meets an old one, the layers from there on are unchanged
+    QVector<LayerSpan> spans;
+    spans.append(LayerSpan(mLayers.at(first)->firstLine(), move, z));
+    int end = mLayers.size();
+    
+    for (; move < mGCode->movesCount(); ++move) {
+        double zm = mGCode->Z(move);
+        if (qAbs(zm - z) > Layers::zTolerance) {
+            int line = mGCode->moveToLine(move);
+            spans.last().lastLine = line - 1;
+            spans.last().endMove = move;
+            
+            GNavigatorItem *old = mRootItem->childAtLine(line);
+            if (line > bottom && old->firstLine() == line && old->info().z == zm) {
+                end = old->row();
+                break;
+            }
+            
+            spans.append(LayerSpan(line, move, zm));
+            z = zm;
+        }
+    }
+    
+    if (end == mLayers.size()) {
+        spans.last().lastLine = mGCode->linesCount() - 1;
+        spans.last().endMove = mGCode->movesCount();
+    }
+    
+    sumLayerTotals(spans);
+    
+    // Layers keeping their lines are updated in place, the rest are replaced
+    int head = 0;
+    int tail = 0;
+    int count = end - first;
+    
+    while (head < qMin(count, spans.size())) {
+        GNavigatorItem *layer = mLayers.at(first + head);
+        const LayerSpan &span = spans.at(head);
+        if (layer->firstLine() != span.firstLine || layer->lastLine() != span.lastLine) {
+            break;
+        }
+        if (layer->lastLine() >= top && layer->firstLine() <= bottom) {
+            refreshLayer(layer, span);
+        }
+        ++head;
+    }
+    
+    while (tail < qMin(count, spans.size()) - head) {
+        GNavigatorItem *layer = mLayers.at(end - tail - 1);
+        const LayerSpan &span = spans.at(spans.size() - tail - 1);
+        if (layer->firstLine() != span.firstLine || layer->lastLine() != span.lastLine) {
+            break;
+        }
+        if (layer->lastLine() >= top && layer->firstLine() <= bottom) {
+            refreshLayer(layer, span);
+        }
+        ++tail;
+    }
+    
+    replaceLayers(first + head, count - head - tail, spans.mid(head, spans.size() - head - tail));
+    
+    buildZIndex();
+    emit dataChanged(top, bottom);
+}
+
+bool GNavigator::canFetchMore(GNavigatorItem *item) const
+{
+    return item && item->type() == GNavigatorItem::Layer && !item->isFetched();
+}
+
+void GNavigator::fetchMore(GNavigatorItem *item)
+{
+    if (!canFetchMore(item)) {
+        return;
+    }
+    
+    attachChildren(item, buildLayerChildren(item));
+}
+
+void GNavigator::prefetch()
+{
+    // Running, or finished with the results not attached yet
+    if (!mPrefetchLayers.isEmpty()) {
+        return;
+    }
+    
+    mPrefetchLayers = unfetchedLayers();
+    if (mPrefetchLayers.isEmpty()) {
+        return;
+    }
+    
+    // Children are built into detached pools and attached in this thread.
+    // Results keep the order of the layers.
+    mPrefetchWatcher.setFuture(QtConcurrent::mapped(mPrefetchLayers, LayerBuilder(this)));
+}
+
+void GNavigator::fetchAll()
+{
+    if (!mPrefetchLayers.isEmpty()) {
+        mPrefetchWatcher.waitForFinished();
+        prefetchFinished();
+    }
+    
+    QList<GNavigatorItem*> layers = unfetchedLayers();
+    if (layers.isEmpty()) {
+        return;
+    }
+    
+    QList<LayerPool> pools = QtConcurrent::blockingMapped<QList<LayerPool> >(layers, LayerBuilder(this));
+    for (int i = 0; i < pools.size(); ++i) {
+        attachChildren(layers.at(i), pools.at(i));
+    }
+}
+
+void GNavigator::prefetchFinished()
+{
+    if (mPrefetchLayers.isEmpty()) {
+        return;
+    }
+    
+    QList<LayerPool> pools = mPrefetchWatcher.future().results();
+    for (int i = 0; i < pools.size(); ++i) {
+        GNavigatorItem *layer = mPrefetchLayers.at(i);
+        if (canFetchMore(layer)) {
+            attachChildren(layer, pools.at(i));
+        } else {
+            delete[] pools.at(i).items;
+        }
+    }
+    mPrefetchLayers.clear();
+}
+
+void GNavigator::cancelPrefetch()
+{
+    if (mPrefetchLayers.isEmpty()) {
+        return;
+    }
+    
+    mPrefetchWatcher.waitForFinished();
+    foreach (const LayerPool &pool, mPrefetchWatcher.future().results()) {
+        delete[] pool.items;
+    }
+    mPrefetchLayers.clear();
+}
+
+QList<GNavigatorItem *> GNavigator::unfetchedLayers() const
+{
+    QList<GNavigatorItem*> layers;
+    foreach (GNavigatorItem *layer, mLayers) {
+        if (canFetchMore(layer)) {
+            layers.append(layer);
+        }
+    }
+    
+    return layers;
+}
+
+void GNavigator::attachChildren(GNavigatorItem *layer, const LayerPool &pool)
+{
+    int count = pool.childCount;
+    if (count > 0) {
+        emit itemsAboutToBeInserted(layer, 0, count - 1);
+    }
+    
+    layer->setPool(pool.items, count);
+    
+    if (count > 0) {
+        emit itemsInserted(layer, 0, count - 1);
+    }
+}
+
+void GNavigator::calculateRouteData(int move, GNavigatorItemInfo *pRouteData) const
 {
     double dE = mGCode->dEe(move);
     double dist = mGCode->distance(move);
@@ -164,41 +461,80 @@ void GNavigator::calculateRouteData(int move, GNavigatorItemInfo *pRouteData)
     if (dist > 0) pRouteData->dEl += dE;
 }
 
+// Finds the layer boundaries in a quick pass over the move Z values, sums
+// the layer totals on the thread pool and then creates the layer items in
+// file order. The routes, commands and comments of a layer are built by
+// fetchMore() when it is first expanded.
 void GNavigator::setupModelData()
 {
-    QList<QVariant> rootData;
-    rootData << QString("root");
-    mRootItem = new GNavigatorItem(0, mGCode->linesCount() - 1, rootData);
+    mRootItem = new GNavigatorItem(0, mGCode->linesCount() - 1, mGCode);
+    mLayerZ.clear();
+    mLayerItems.clear();
     
     if (mGCode->linesCount() == 0) return;
     
     double z = 0.0;
-    GNavigatorItemInfo layerData(z);
+    QVector<LayerSpan> spans;
+    spans.append(LayerSpan(0, 0, z));
+    
+    for (int move = 0; move < mGCode->movesCount(); ++move) {
+        double zm = mGCode->Z(move);
+        if (qAbs(zm - z) > Layers::zTolerance) {
+            int line = mGCode->moveToLine(move);
+            spans.last().lastLine = line - 1;
+            spans.last().endMove = move;
+            
+            spans.append(LayerSpan(line, move, zm));
+            z = zm;
+        }
+    }
+    
+    spans.last().lastLine = mGCode->linesCount() - 1;
+    spans.last().endMove = mGCode->movesCount();
+    
+    sumLayerTotals(spans);
+    
+    mLayers.reserve(spans.size());
+    foreach (const LayerSpan &span, spans) {
+        mLayers.append(createLayerItem(span));
+    }
+    mRootItem->setChildren(mLayers.constData(), mLayers.size());
+    renumberLayers(0);
+    
+    buildZIndex();
+    
+//    GNavigatorItem *firstItem = mRootItem->child(0);
+//    mGCode->show(firstItem->firstLine(), firstItem->lastLine());
+}
+
+void GNavigator::clearModelData()
+{
+    qDeleteAll(mLayers);
+    mLayers.clear();
+    delete mRootItem;
+    mRootItem = NULL;
+}
+
+// Builds the routes, commands and comments of the layer into a detached
+// pool. Reads the data only, so it may run in a worker thread.
+GNavigator::LayerPool GNavigator::buildLayerChildren(GNavigatorItem *layer) const
+{
+    double z = layer->info().z;
     GNavigatorItemInfo routeData(z);
     
-    GNavigatorItem *layer = new GNavigatorItem(0, mRootItem);
-    GNavigatorItem *comment = NULL;
-    GNavigatorItem *route = NULL;
+    QVector<BuildNode> nodes;
+    int comment = -1;
+    int route = -1;
     
-    for (int line = 0; line < mGCode->linesCount(); ++line) {
+    for (int line = layer->firstLine(); line <= layer->lastLine(); ++line) {
         GCodeLine::LineType lineType = mGCode->lineType(line);
         GNavigatorItem::ItemType itemType = GNavigatorItem::Invalid;
         int move = -1;
         
+        // All the moves of a layer have its Z
         if (lineType == GCodeLine::Command) {
             move = mGCode->lineToMove(line);
-            if (move >= 0) {
-                double zm = mGCode->Z(move);
-                if (z == zm) {
-                    itemType = GNavigatorItem::Route;
-                    
-                } else {
-                    itemType = GNavigatorItem::Layer;
-                }
-                
-            } else {
-                itemType = GNavigatorItem::Command;
-            }
+            itemType = move >= 0 ? GNavigatorItem::Route : GNavigatorItem::Command;
             
         } else if (lineType == GCodeLine::Comment) {
             itemType = GNavigatorItem::Comment;
@@ -207,40 +543,33 @@ void GNavigator::setupModelData()
             continue;
         }
         
-        
         switch (itemType) {
         case GNavigatorItem::Comment:
-            if (!comment) {
-                comment = new GNavigatorItem(line, route ? route : layer);
-                comment->setType(itemType);
-                comment->appendData(";");
+            if (comment < 0) {
+                comment = startItem(&nodes, itemType, line, route);
             }
             break;
             
-        case GNavigatorItem::Command: {
-            finishCommentItem(comment, line - 1);
-            comment = NULL;
+        case GNavigatorItem::Command:
+            finishCommentItem(&nodes, comment, line - 1);
+            comment = -1;
             
-            GNavigatorItem *command = new GNavigatorItem(line, route ? route : layer);
-            command->setType(itemType);
-            command->appendData(mGCode->command(line));
-            command->appendData(mGCode->comment(line));
-        }
+            startItem(&nodes, itemType, line, route);
             break;
             
         case GNavigatorItem::Route: {
-            finishCommentItem(comment, line - 1);
-            comment = NULL;
+            finishCommentItem(&nodes, comment, line - 1);
+            comment = -1;
             
-            if (!route) {
-                route = startRouteItem(line, layer);
+            if (route < 0) {
+                route = startItem(&nodes, itemType, line, -1);
                 routeData = GNavigatorItemInfo(z);
                 
             } else {
                 if (mGCode->dEe(move) == 0.0 && mGCode->distance(move) > 0.0 && routeData.dE != 0.0) {
-                    finishRouteItem(route, line - 1, routeData, &layerData);
+                    finishRouteItem(&nodes, route, line - 1, routeData);
                     
-                    route = startRouteItem(line, layer);
+                    route = startItem(&nodes, itemType, line, -1);
                     routeData = GNavigatorItemInfo(z);
                 }
             }
@@ -249,105 +578,225 @@ void GNavigator::setupModelData()
         }
             break;
             
-        case GNavigatorItem::Layer: {
-            finishCommentItem(comment, line - 1);
-            comment = NULL;
-            finishRouteItem(route, line - 1, routeData, &layerData);
-            route = NULL;
-            
-            finishLayerItem(layer, line - 1, layerData);
-            
-            layer = new GNavigatorItem(line, mRootItem);
-            z = mGCode->Z(move);
-            layerData = GNavigatorItemInfo(z);
-            
-            route = startRouteItem(line, layer);
-            routeData = GNavigatorItemInfo(z);
-            calculateRouteData(move, &routeData);
-        }
-            break;
-            
-//        case GNavigatorItem::Command: {
-//        }
-//            break;
-
         default:
             break;
         }
         
     }
     
-    finishCommentItem(comment, mGCode->linesCount() - 1);
-    finishRouteItem(route, mGCode->linesCount() - 1, routeData, &layerData);
-    finishLayerItem(layer, mGCode->linesCount() - 1, layerData);
+    finishCommentItem(&nodes, comment, layer->lastLine());
+    finishRouteItem(&nodes, route, layer->lastLine(), routeData);
     
-//    GNavigatorItem *firstItem = mRootItem->child(0);
-//    mGCode->show(firstItem->firstLine(), firstItem->lastLine());
+    return packLayer(layer, nodes);
 }
 
-void GNavigator::finishLayerItem(GNavigatorItem *item, int lastLine, GNavigatorItemInfo data)
+// Lays the nodes out breadth first, so the children of every item are
+// contiguous, and links them by pointers
+GNavigator::LayerPool GNavigator::packLayer(GNavigatorItem *layer, const QVector<BuildNode> &nodes) const
 {
-    if (item) {
-        item->setType(GNavigatorItem::Layer);
-        item->setLastLine(lastLine);
-        item->setInfo(data);
+    LayerPool pool;
+    int size = nodes.size();
+    if (size == 0) {
+        return pool;
+    }
+    
+    // Children lists by counting sort on the parent, the layer is at 0 and node i at i + 1.
+    // Nodes are created in line order, so the lists stay sorted by line.
+    QVector<int> firstChild(size + 2, 0);
+    for (int i = 0; i < size; ++i) {
+        ++firstChild[nodes.at(i).parent + 2];
+    }
+    for (int i = 1; i < firstChild.size(); ++i) {
+        firstChild[i] += firstChild.at(i - 1);
+    }
+    
+    QVector<int> children(size);
+    QVector<int> next(firstChild);
+    for (int i = 0; i < size; ++i) {
+        children[next[nodes.at(i).parent + 1]++] = i;
+    }
+    
+    QVector<int> order;
+    order.reserve(size);
+    auto appendChildren = [&](int parent) {
+        for (int c = firstChild.at(parent + 1); c < firstChild.at(parent + 2); ++c) {
+            order.append(children.at(c));
+        }
+    };
+    appendChildren(-1);
+    for (int i = 0; i < order.size(); ++i) {
+        appendChildren(order.at(i));
+    }
+    
+    QVector<int> position(size);
+    for (int p = 0; p < size; ++p) {
+        position[order.at(p)] = p;
+    }
+    
+    pool.items = new GNavigatorItem[size];
+    pool.childCount = firstChild.at(1);
+    
+    for (int p = 0; p < size; ++p) {
+        int n = order.at(p);
+        const BuildNode &node = nodes.at(n);
+        GNavigatorItem &item = pool.items[p];
+        
+        item.mParentItem = node.parent < 0 ? layer : pool.items + position.at(node.parent);
+        item.mGCode = mGCode;
+        item.mType = node.type;
+        item.mFirstLine = node.firstLine;
+        item.mLastLine = node.lastLine;
+        item.mTextLine = node.textLine;
+        item.mInfo = node.info;
+        
+        int first = firstChild.at(n + 1);
+        int count = firstChild.at(n + 2) - first;
+        if (count > 0) {
+            item.setChildren(pool.items + position.at(children.at(first)), count);
+        }
         
-        mZMap.insert(data.z, item);
+        for (int c = 0; c < count; ++c) {
+            pool.items[position.at(children.at(first + c))].mRow = c;
+        }
+    }
+    
+    for (int c = 0; c < pool.childCount; ++c) {
+        pool.items[c].mRow = c;
     }
+    
+    return pool;
+}
+
+GNavigatorItem *GNavigator::createLayerItem(const LayerSpan &span) const
+{
+    GNavigatorItem *layer = new GNavigatorItem(span.firstLine, span.lastLine, mGCode, mRootItem);
+    layer->setType(GNavigatorItem::Layer);
+    layer->setInfo(span.info);
+    
+    return layer;
 }
 
-GNavigatorItem* GNavigator::startRouteItem(int firstLine, GNavigatorItem *layer)
+// Every layer sums its own moves in order, so the totals do not depend on scheduling
+void GNavigator::sumLayerTotals(QVector<LayerSpan> &spans) const
 {
-    GNavigatorItem *route = new GNavigatorItem(firstLine, layer);
-    route->setType(GNavigatorItem::Route);
+    QtConcurrent::blockingMap(spans, [this](LayerSpan &span) {
+        span.info = GNavigatorItemInfo(span.info.z);
+        for (int move = span.firstMove; move < span.endMove; ++move) {
+            calculateRouteData(move, &span.info);
+        }
+    });
+}
+
+// Updates the totals of the layer and rebuilds its children if they were built
+void GNavigator::refreshLayer(GNavigatorItem *layer, const LayerSpan &span)
+{
+    layer->setInfo(span.info);
+    emit itemsChanged(mRootItem, layer->row(), layer->row());
+    
+    if (!layer->isFetched()) {
+        return;
+    }
     
-    return route;
+    int count = layer->childCount();
+    if (count > 0) {
+        emit itemsAboutToBeRemoved(layer, 0, count - 1);
+    }
+    
+    layer->setPool(NULL, 0);
+    
+    if (count > 0) {
+        emit itemsRemoved(layer, 0, count - 1);
+    }
+    
+    attachChildren(layer, buildLayerChildren(layer));
 }
 
-void GNavigator::finishRouteItem(GNavigatorItem *item, int lastLine, GNavigatorItemInfo data, GNavigatorItemInfo *pLayerData)
+// Replaces count layers from the row first with the layers of the spans
+void GNavigator::replaceLayers(int first, int count, const QVector<LayerSpan> &spans)
 {
-    if (item) {
-        item->setLastLine(lastLine);
-        item->setInfo(data);
+    if (count > 0) {
+        emit itemsAboutToBeRemoved(mRootItem, first, first + count - 1);
         
-        pLayerData->l += data.l;
-        pLayerData->lE += data.lE;
-        pLayerData->dE += data.dE;
-        pLayerData->dEl += data.dEl;
+        for (int i = first; i < first + count; ++i) {
+            delete mLayers.at(i);
+        }
+        mLayers.remove(first, count);
+        mRootItem->setChildren(mLayers.constData(), mLayers.size());
+        renumberLayers(first);
+        buildZIndex(); // No deleted layers for the slots
         
+        emit itemsRemoved(mRootItem, first, first + count - 1);
+    }
+    
+    if (!spans.isEmpty()) {
+        emit itemsAboutToBeInserted(mRootItem, first, first + spans.size() - 1);
+        
+        mLayers.insert(first, spans.size(), NULL);
+        for (int i = 0; i < spans.size(); ++i) {
+            mLayers[first + i] = createLayerItem(spans.at(i));
+        }
+        mRootItem->setChildren(mLayers.constData(), mLayers.size());
+        renumberLayers(first);
+        buildZIndex();
+        
+        emit itemsInserted(mRootItem, first, first + spans.size() - 1);
+    }
+}
+
+void GNavigator::renumberLayers(int first)
+{
+    for (int i = first; i < mLayers.size(); ++i) {
+        mLayers.at(i)->mRow = i;
     }
 }
 
-void GNavigator::finishCommentItem(GNavigatorItem *item, int lastLine)
+int GNavigator::startItem(QVector<BuildNode> *nodes, GNavigatorItem::ItemType type, int firstLine, int parent) const
 {
-    if (item) {
-        item->setLastLine(lastLine);
+    BuildNode node;
+    node.parent = parent;
+    node.type = type;
+    node.firstLine = firstLine;
+    node.lastLine = firstLine;
+    node.textLine = firstLine;
+    nodes->append(node);
+    
+    return nodes->size() - 1;
+}
+
+void GNavigator::finishRouteItem(QVector<BuildNode> *nodes, int item, int lastLine, GNavigatorItemInfo data) const
+{
+    if (item >= 0) {
+        BuildNode &node = (*nodes)[item];
+        node.lastLine = qMax(lastLine, node.firstLine);
+        node.info = data;
+    }
+}
+
+void GNavigator::finishCommentItem(QVector<BuildNode> *nodes, int item, int lastLine) const
+{
+    if (item >= 0) {
+        BuildNode &node = (*nodes)[item];
+        node.lastLine = qMax(lastLine, node.firstLine);
         
-        int line = item->firstLine();
-        QString text = mGCode->comment(line++);
-        while (text.trimmed().isEmpty() && line <= lastLine) {
-            text = mGCode->comment(line++);
+        // The first line with a non-empty comment is shown
+        int line = node.firstLine;
+        while (mGCode->comment(line).trimmed().isEmpty() && line < node.lastLine) {
+            ++line;
         }
-        item->appendData(text);
+        node.textLine = line;
     }
 }
 
-Qt::CheckState GNavigator::testState(GNavigatorItem *item, const QBitArray &state) const
+Qt::CheckState GNavigator::testState(GNavigatorItem *item, int count)
 {
-    QBitArray ba(state);
-    ba.fill(true, item->firstLine(), item->lastLine() + 1);
-    ba ^= state;
-    
-    int cnt = ba.count(true);
-    if (cnt == 0) {
-        return Qt::Checked;
+    if (count == 0) {
+        return Qt::Unchecked;
     }
     
     int len = item->lastLine() - item->firstLine() + 1;
-    if (cnt == len) {
-        return Qt::Unchecked;
+    if (count == len) {
+        return Qt::Checked;
     }
     
     return Qt::PartiallyChecked;
 }
-
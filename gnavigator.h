@@ -2,7 +2,8 @@
 #define GNAVIGATOR_H
 
 #include <QObject>
-#include <QMap>
+#include <QVector>
+#include <QFutureWatcher>
 
 #include "gcode.h"
 #include "gnavigatoritem.h"
@@ -15,14 +16,31 @@ public:
     virtual ~GNavigator();
  
     
+    GCode* gcode() const { return mGCode; }
     GNavigatorItem* root() const { return mRootItem; }
 //    GNavigatorItem* parent(GNavigatorItem* child) const;
 //    GNavigatorItem* child(GNavigatorItem* parent) const;
     
-    GNavigatorItem* itemAtZ(double z);
+    // Layer lookup by Z. Layers with the same Z are returned in file order.
     GNavigatorItem* itemAtZ(double z) const;
+    GNavigatorItem* itemNearestZ(double z) const;
+    GNavigatorItem* itemFloorZ(double z) const; // The highest layer at or below z
+    GNavigatorItem* itemCeilZ(double z) const;  // The lowest layer at or above z
+    QList<GNavigatorItem*> itemsInZRange(double minZ, double maxZ) const;
     
-    Qt::CheckState selected(GNavigatorItem* item) const { return testState(item, mGCode->selection()); }
+    // The deepest item containing the line and its ancestors from the layer down.
+    // Fetches the children of the layer if needed.
+    GNavigatorItem* itemAtLine(int line);
+    QList<GNavigatorItem*> pathAtLine(int line);
+    
+    // Layer children are built on demand
+    bool canFetchMore(GNavigatorItem* item) const;
+    void fetchMore(GNavigatorItem* item);
+    void prefetch(); // Builds the children of all the layers in the background
+    void fetchAll(); // Builds the children of all the layers on the thread pool and waits
+    
+    Qt::CheckState selected(GNavigatorItem* item) const;
+    QVector<Qt::CheckState> selectedChildren(GNavigatorItem* parent) const;
     void selectAll() { mGCode->selectAll(); }
     void select(GNavigatorItem* item) { mGCode->select(item->firstLine(), item->lastLine()); }
     void select(GNavigatorItem* begin, GNavigatorItem* end);
@@ -32,7 +50,8 @@ public:
     void toggleSelection(GNavigatorItem* item) { mGCode->toggleSelection(item->firstLine(), item->lastLine()); }
     void toggleSelection(GNavigatorItem* begin, GNavigatorItem* end);
     
-    Qt::CheckState visible(GNavigatorItem* item) const { return testState(item, mGCode->visibility()); }
+    Qt::CheckState visible(GNavigatorItem* item) const;
+    QVector<Qt::CheckState> visibleChildren(GNavigatorItem* parent) const;
     void showAll() { mGCode->showAll(); }
     void show(GNavigatorItem* item) { mGCode->show(item->firstLine(), item->lastLine()); }
     void show(GNavigatorItem* begin, GNavigatorItem* end);
@@ -48,27 +67,90 @@ signals:
     void visibilityChanged(int top, int bottom);
     void beginReset();
     void endReset();
+    void itemsAboutToBeInserted(GNavigatorItem* parent, int first, int last);
+    void itemsInserted(GNavigatorItem* parent, int first, int last);
+    void itemsAboutToBeRemoved(GNavigatorItem* parent, int first, int last);
+    void itemsRemoved(GNavigatorItem* parent, int first, int last);
+    void itemsChanged(GNavigatorItem* parent, int first, int last);
     
 public slots:
     
 protected slots:
     void beginResetData();
     void endResetData();
+    void beginUpdateData(int top, int bottom);
+    void updateData(int top, int bottom);
+    void prefetchFinished();
     
 private:
+    // Item under construction, linked to its parent by index
+    struct BuildNode {
+        BuildNode() : parent(-1), type(GNavigatorItem::Invalid), firstLine(0), lastLine(0), textLine(0) {}
+        int parent; // -1 for the children of the layer
+        GNavigatorItem::ItemType type;
+        int firstLine;
+        int lastLine;
+        int textLine;
+        GNavigatorItemInfo info;
+    };
+    
+    // Descendants of a layer, the first childCount items are its children
+    struct LayerPool {
+        LayerPool() : items(NULL), childCount(0) {}
+        GNavigatorItem *items;
+        int childCount;
+    };
+    
+    // Layer found by the boundary pass, moves [firstMove, endMove)
+    struct LayerSpan {
+        LayerSpan(int firstLine = 0, int firstMove = 0, double z = 0.0)
+            : firstLine(firstLine), lastLine(firstLine), firstMove(firstMove), endMove(firstMove), info(z) {}
+        int firstLine;
+        int lastLine;
+        int firstMove;
+        int endMove;
+        GNavigatorItemInfo info;
+    };
+    
+    // Builds the children of one layer, for QtConcurrent::mapped()
+    struct LayerBuilder {
+        typedef LayerPool result_type;
+        LayerBuilder(const GNavigator *navigator) : navigator(navigator) {}
+        LayerPool operator()(GNavigatorItem *layer) const { return navigator->buildLayerChildren(layer); }
+        const GNavigator *navigator;
+    };
+    
     void setupModelData();
-    void finishLayerItem(GNavigatorItem *item, int lastLine, GNavigatorItemInfo data);
-    GNavigatorItem *startRouteItem(int firstLine, GNavigatorItem *layer);
-    void finishRouteItem(GNavigatorItem *item, int lastLine, GNavigatorItemInfo data, GNavigatorItemInfo *layerData);
-    void finishCommentItem(GNavigatorItem *item, int lastLine);
-    void calculateRouteData(int move, GNavigatorItemInfo *pRouteData);
+    void clearModelData();
+    LayerPool buildLayerChildren(GNavigatorItem *layer) const;
+    LayerPool packLayer(GNavigatorItem *layer, const QVector<BuildNode> &nodes) const;
+    void attachChildren(GNavigatorItem *layer, const LayerPool &pool);
+    QList<GNavigatorItem*> unfetchedLayers() const;
+    void cancelPrefetch();
+    void sumLayerTotals(QVector<LayerSpan> &spans) const;
+    void refreshLayer(GNavigatorItem *layer, const LayerSpan &span);
+    void replaceLayers(int first, int count, const QVector<LayerSpan> &spans);
+    void renumberLayers(int first);
+    void buildZIndex();
+    int firstZIndex(double z) const;
+    int lastZIndex(double z) const;
+    GNavigatorItem *createLayerItem(const LayerSpan &span) const;
+    int startItem(QVector<BuildNode> *nodes, GNavigatorItem::ItemType type, int firstLine, int parent) const;
+    void finishRouteItem(QVector<BuildNode> *nodes, int item, int lastLine, GNavigatorItemInfo data) const;
+    void finishCommentItem(QVector<BuildNode> *nodes, int item, int lastLine) const;
+    void calculateRouteData(int move, GNavigatorItemInfo *pRouteData) const;
     
-    Qt::CheckState testState(GNavigatorItem* item, const QBitArray &state) const;
+    static Qt::CheckState testState(GNavigatorItem* item, int count);
     
     GCode *mGCode;
     GNavigatorItem *mRootItem;
+    QVector<GNavigatorItem*> mLayers; // Children of the root
+    
+    QVector<double> mLayerZ; // Layer Z values in ascending order
+    QVector<GNavigatorItem*> mLayerItems; // Layers in mLayerZ order
     
-    QMap<double, GNavigatorItem*> mZMap;
+    QFutureWatcher<LayerPool> mPrefetchWatcher;
+    QList<GNavigatorItem*> mPrefetchLayers;
 };
 
 #endif // GNAVIGATOR_H
@@ -1,43 +1,52 @@
 #include "gnavigatoritem.h"
 
+#include "gcode.h"
+
 #include <QStringList>
 #include <QDebug>
-
-GNavigatorItem::GNavigatorItem(int firstLine, int lastLine, const QList<QVariant> &data, GNavigatorItem *parent)
-    : mParentItem(parent),
+#include <algorithm>
+
+GNavigatorItem::GNavigatorItem()
+    : mParentItem(NULL),
+      mChildItems(NULL),
+      mChildTable(NULL),
+      mChildCount(0),
+      mPool(NULL),
+      mGCode(NULL),
       mType(Invalid),
-      mData(data),
-      mFirstLine(firstLine),
-      mLastLine(firstLine)
+      mRow(0),
+      mFetched(false),
+      mFirstLine(0),
+      mLastLine(0),
+      mTextLine(0)
 {
-    if (mParentItem == 0) {
-        mType = Root;
-        
-    } else {
-        mParentItem->appendChild(this);
-    }
-    
-    setLastLine(lastLine);
 }
 
-GNavigatorItem::GNavigatorItem(int firstLine, GNavigatorItem *parent)
+GNavigatorItem::GNavigatorItem(int firstLine, int lastLine, const GCode *data, GNavigatorItem *parent)
     : mParentItem(parent),
+      mChildItems(NULL),
+      mChildTable(NULL),
+      mChildCount(0),
+      mPool(NULL),
+      mGCode(data),
       mType(Invalid),
+      mRow(0),
+      mFetched(false),
       mFirstLine(firstLine),
-      mLastLine(firstLine)
+      mLastLine(firstLine),
+      mTextLine(firstLine)
 {
     if (mParentItem == 0) {
         mType = Root;
-        
-    } else {
-        mParentItem->appendChild(this);
     }
+    
+    setLastLine(lastLine);
 }
 
 GNavigatorItem::~GNavigatorItem()
 {
 //    qDebug() << __PRETTY_FUNCTION__;
-    qDeleteAll(mChildItems);
+    delete[] mPool;
 }
 
 bool GNavigatorItem::setLastLine(int lastLine)
@@ -56,29 +65,45 @@ void GNavigatorItem::setInfo(const GNavigatorItemInfo &info)
     mInfo = info;
 }
 
-void GNavigatorItem::setData(const QList<QVariant> &data)
+void GNavigatorItem::setChildren(GNavigatorItem *children, int count)
 {
-    mData = data;
+    mChildItems = children;
+    mChildTable = NULL;
+    mChildCount = count;
 }
 
-void GNavigatorItem::appendData(const QVariant &dataItem)
+void GNavigatorItem::setChildren(GNavigatorItem * const *children, int count)
 {
-    mData.append(dataItem);
+    mChildItems = NULL;
+    mChildTable = children;
+    mChildCount = count;
 }
 
-void GNavigatorItem::appendChild(GNavigatorItem *item)
+// Takes the ownership of the descendants, the first childCount of them are the children
+void GNavigatorItem::setPool(GNavigatorItem *pool, int childCount)
 {
-    mChildItems.append(item);
+    delete[] mPool;
+    mPool = pool;
+    setChildren(pool, childCount);
+    
+    for (int i = 0; i < childCount; ++i) {
+        pool[i].mParentItem = this;
+    }
+    mFetched = true;
 }
 
 GNavigatorItem *GNavigatorItem::child(int row)
 {
-    return mChildItems.value(row);
+    if (row < 0 || row >= mChildCount) {
+        return NULL;
+    }
+    
+    return mChildTable ? mChildTable[row] : mChildItems + row;
 }
 
 GNavigatorItem& GNavigatorItem::child(int row) const
 {
-    return *(mChildItems.value(row));
+    return mChildTable ? *(mChildTable[row]) : mChildItems[row];
 }
 
 void GNavigatorItem::setType(GNavigatorItem::ItemType type)
@@ -90,29 +115,71 @@ void GNavigatorItem::setType(GNavigatorItem::ItemType type)
 
 int GNavigatorItem::childCount() const
 {
-    return mChildItems.count();
+    return mChildCount;
 }
 
 int GNavigatorItem::dataSize() const
 {
-    return mData.count();
+    switch (mType) {
+    case Root: 
+        return 1;
+        
+    case Command:
+    case Comment:
+        return 2;
+        
+    default:
+        return 0;
+    }
 }
 
 QVariant GNavigatorItem::data(int i) const
 {
-    return mData.value(i);
+    switch (mType) {
+    case Root:
+        return i == 0 ? QVariant(QString("root")) : QVariant();
+        
+    case Command:
+        if (i == 0) return mGCode->command(mTextLine);
+        if (i == 1) return mGCode->comment(mTextLine);
+        break;
+        
+    case Comment:
+        if (i == 0) return QString(";");
+        if (i == 1) return mGCode->comment(mTextLine);
+        break;
+        
+    default:
+        break;
+    }
+    
+    return QVariant();
+}
+
+// Children are stored in line order and do not overlap
+GNavigatorItem *GNavigatorItem::childAtLine(int line) const
+{
+    int first = 0;
+    int count = mChildCount;
+    while (count > 0) {
+        int step = count / 2;
+        if (child(first + step).mFirstLine <= line) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    
+    if (first == 0) {
+        return NULL;
+    }
+    
+    GNavigatorItem &item = child(first - 1);
+    return line <= item.mLastLine ? &item : NULL;
 }
 
 GNavigatorItem *GNavigatorItem::parentItem()
 {
     return mParentItem;
 }
-
-int GNavigatorItem::row() const
-{
-    if (mParentItem) {
-        return mParentItem->mChildItems.indexOf(const_cast<GNavigatorItem*>(this));
-    }
-
-    return 0;
-}
@@ -4,6 +4,8 @@
 #include <QList>
 #include <QVariant>
 
+class GCode;
+
 struct GNavigatorItemInfo {
     GNavigatorItemInfo(double z = 0.0, double l = 0.0, double lE = 0.0, double dE = 0.0, double dEl = 0.0) 
         : z(z), l(l), lE(lE), dE(dE), dEl(dEl) {}
@@ -14,8 +16,14 @@ struct GNavigatorItemInfo {
     double dEl; // extrusion length excepting retracts
 };
 
+// Navigator tree node. The root and the layers are allocated one by one,
+// the descendants of a layer live in one array owned by the layer with
+// the children of every item stored contiguously. Item texts are read
+// from the GCode lines on request.
 class GNavigatorItem
 {
+    friend class GNavigator;
+    
 public:
     enum ItemType {
         Invalid = 0x0,
@@ -26,22 +34,21 @@ public:
         Route = 0x10
     };
     
-    GNavigatorItem(int firstLine, int lastLine, const QList<QVariant> &data, GNavigatorItem *parent = 0);
-    GNavigatorItem(int firstLine, GNavigatorItem *parent = 0);
+    GNavigatorItem();
+    GNavigatorItem(int firstLine, int lastLine, const GCode *data, GNavigatorItem *parent = 0);
     ~GNavigatorItem();
 
     bool setLastLine(int lastLine);
     void setInfo(const GNavigatorItemInfo &info);
-    void setData(const QList<QVariant> &data);
-    void appendData(const QVariant &dataItem);
     
-    void appendChild(GNavigatorItem *child);
+    bool isFetched() const { return mFetched; }
 
     GNavigatorItem* parentItem();
     GNavigatorItem* child(int row);
     GNavigatorItem& child(int row) const;
-    GNavigatorItem* firstChild() { return mChildItems.isEmpty() ? NULL : mChildItems.first(); }
-    GNavigatorItem* lastChild() { return mChildItems.isEmpty() ? NULL : mChildItems.last(); }
+    GNavigatorItem* firstChild() { return child(0); }
+    GNavigatorItem* lastChild() { return child(mChildCount - 1); }
+    GNavigatorItem* childAtLine(int line) const;
     
     ItemType type() const { return mType; }
     void setType(ItemType type);
@@ -49,7 +56,7 @@ public:
     int firstLine() const { return mFirstLine; }
     int lastLine() const { return mLastLine; }
 
-    int row() const;
+    int row() const { return mRow; }
     int childCount() const;
     
     GNavigatorItemInfo info() const { return mInfo; }
@@ -60,16 +67,29 @@ public:
     bool operator!=(const GNavigatorItem &v) const { return !(*this == v); }
     
 private:
+    Q_DISABLE_COPY(GNavigatorItem)
+    
+    void setChildren(GNavigatorItem *children, int count);
+    void setChildren(GNavigatorItem * const *children, int count);
+    void setPool(GNavigatorItem *pool, int childCount);
+    
     GNavigatorItem *mParentItem;
-    QList<GNavigatorItem*> mChildItems;
+    GNavigatorItem *mChildItems; // The first child
+    GNavigatorItem * const *mChildTable; // The children of the root
+    int mChildCount;
+    
+    GNavigatorItem *mPool; // The descendants of a layer
+    const GCode *mGCode;
     
     ItemType mType;
+    int mRow;
+    bool mFetched;
     
     GNavigatorItemInfo mInfo;
-    QList<QVariant> mData;
     
     int mFirstLine;
     int mLastLine;
+    int mTextLine; // The line shown by command and comment items
 };
 
 #endif // GNAVIGATORITEM_H
@@ -0,0 +1,212 @@
+#include "gprintersimulator.h"
+
+#include "gcodeline.h"
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+GPrinterSimulator::GPrinterSimulator(QObject *parent)
+    : QObject(parent),
+      mMaster(-1),
+      mSlave(-1),
+      mNotifier(NULL),
+      mTimer(new QTimer(this)),
+      mCommandTime(0),
+      mErrorInterval(0),
+      mBufferSize(128),
+      mQueueSize(4),
+      mExpected(0),
+      mReceived(0),
+      mExecuted(0),
+      mResends(0),
+      mDropped(0)
+{
+    mTimer->setSingleShot(true);
+    connect(mTimer, SIGNAL(timeout()), this, SLOT(execute()));
+}
+
+GPrinterSimulator::~GPrinterSimulator()
+{
+    close();
+}
+
+bool GPrinterSimulator::open()
+{
+    if (isOpen()) {
+        return false;
+    }
+    
+    mMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if (mMaster < 0) {
+        return false;
+    }
+    if (grantpt(mMaster) != 0 || unlockpt(mMaster) != 0) {
+        close();
+        return false;
+    }
+    
+    mPortName = QString::fromLocal8Bit(ptsname(mMaster));
+    mSlave = ::open(mPortName.toLocal8Bit().constData(), O_RDWR | O_NOCTTY);
+    if (mSlave < 0) {
+        close();
+        return false;
+    }
+    
+    // No echo and no line editing
+    termios tio;
+    if (tcgetattr(mSlave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(mSlave, TCSANOW, &tio);
+    }
+    
+    mInput.clear();
+    mQueue.clear();
+    mExpected = 0;
+    mReceived = 0;
+    mExecuted = 0;
+    mResends = 0;
+    mDropped = 0;
+    
+    mNotifier = new QSocketNotifier(mMaster, QSocketNotifier::Read, this);
+    connect(mNotifier, SIGNAL(activated(int)), this, SLOT(readMaster()));
+    return true;
+}
+
+void GPrinterSimulator::close()
+{
+    mTimer->stop();
+    delete mNotifier;
+    mNotifier = NULL;
+    
+    if (mSlave >= 0) {
+        ::close(mSlave);
+        mSlave = -1;
+    }
+    if (mMaster >= 0) {
+        ::close(mMaster);
+        mMaster = -1;
+    }
+    mPortName.clear();
+}
+
+void GPrinterSimulator::readMaster()
+{
+    char data[4096];
+    ssize_t n = ::read(mMaster, data, sizeof(data));
+    if (n <= 0) {
+        return;
+    }
+    
+    // The buffer is drained to the queue as it fills, the bytes that find
+    // it full are lost
+    int offset = 0;
+    int left = int(n);
+    while (left > 0 && mInput.size() < mBufferSize) {
+        int size = qMin(left, mBufferSize - mInput.size());
+        mInput.append(data + offset, size);
+        offset += size;
+        left -= size;
+        processInput();
+    }
+    mDropped += left;
+}
+
+void GPrinterSimulator::processInput()
+{
+    int end;
+    while (mQueue.size() < mQueueSize && (end = mInput.indexOf('\n')) >= 0) {
+        QByteArray line = mInput.left(end).trimmed();
+        mInput.remove(0, end + 1);
+        // Marlin flushes its receive buffer on a line error, the lines
+        // received with the bad one get no answer
+        if (!line.isEmpty() && !receive(line)) {
+            mInput.clear();
+            break;
+        }
+    }
+}
+
+bool GPrinterSimulator::receive(const QByteArray &line)
+{
+    ++mReceived;
+    QByteArray command = line;
+    
+    if (line.startsWith('N')) {
+        int star = line.lastIndexOf('*');
+        if (star < 0) {
+            requestResend("No Checksum with line number, Last Line: ");
+            return false;
+        }
+        
+        bool injected = mErrorInterval > 0 && mReceived % mErrorInterval == 0;
+        if (injected || line.mid(star + 1).toInt() != GCodeLine::checksum(line.left(star))) {
+            requestResend("checksum mismatch, Last Line: ");
+            return false;
+        }
+        
+        int space = line.indexOf(' ');
+        int number = line.mid(1, (space < 0 ? star : space) - 1).toInt();
+        command = space < 0 ? QByteArray() : line.mid(space + 1, star - space - 1).trimmed();
+        
+        // M110 sets the number regardless of the expected one
+        if (command.startsWith("M110")) {
+            int n = command.indexOf('N');
+            mExpected = (n < 0 ? number : command.mid(n + 1).toInt()) + 1;
+        } else if (number != mExpected) {
+            requestResend("Line Number is not Last Line Number+1, Last Line: ");
+            return false;
+        } else {
+            ++mExpected;
+        }
+    }
+    
+    mQueue.append(command);
+    if (!mTimer->isActive()) {
+        mTimer->start(mCommandTime);
+    }
+    return true;
+}
+
+void GPrinterSimulator::requestResend(const QByteArray &error)
+{
+    ++mResends;
+    reply("Error:" + error + QByteArray::number(mExpected - 1));
+    reply("Resend: " + QByteArray::number(mExpected));
+    reply("ok");
+}
+
+void GPrinterSimulator::execute()
+{
+    if (mQueue.isEmpty()) {
+        return;
+    }
+    
+    QByteArray command = mQueue.takeFirst();
+    ++mExecuted;
+    emit commandExecuted(command);
+    reply("ok");
+    
+    // The freed slot takes the next line waiting in the buffer
+    processInput();
+    if (!mQueue.isEmpty() && !mTimer->isActive()) {
+        mTimer->start(mCommandTime);
+    }
+}
+
+void GPrinterSimulator::reply(const QByteArray &text)
+{
+    QByteArray line = text + "\n";
+    qint64 written = 0;
+    while (written < line.size()) {
+        ssize_t n = ::write(mMaster, line.constData() + written, line.size() - written);
+        if (n <= 0) {
+            return;
+        }
+        written += n;
+    }
+}
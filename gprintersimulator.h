@@ -0,0 +1,78 @@
+#ifndef GPRINTERSIMULATOR_H
+#define GPRINTERSIMULATOR_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+
+class QSocketNotifier;
+class QTimer;
+
+// A printer on a pseudo terminal that answers as Marlin does, to run
+// GSender without hardware. Numbered lines are checked for their number
+// and checksum and a resend is asked for on a mismatch. Commands take
+// commandTime to execute, one at a time, and are answered with an ok when
+// done. Lines move from the receive buffer of bufferSize bytes to the
+// command queue while it has room; bytes received on a full buffer are
+// dropped and counted, as Marlin's serial interrupt does. The receive
+// buffer is flushed on a line error.
+class GPrinterSimulator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GPrinterSimulator(QObject *parent = 0);
+    ~GPrinterSimulator();
+    
+    bool open();
+    void close();
+    bool isOpen() const { return mMaster >= 0; }
+    QString portName() const { return mPortName; } // To open with GTtyDevice
+    
+    int commandTime() const { return mCommandTime; }
+    void setCommandTime(int ms) { mCommandTime = qMax(ms, 0); }
+    int errorInterval() const { return mErrorInterval; }
+    void setErrorInterval(int lines) { mErrorInterval = qMax(lines, 0); } // Every n-th line fails its checksum, 0 for none
+    int bufferSize() const { return mBufferSize; }
+    void setBufferSize(int bytes) { mBufferSize = qMax(bytes, 1); } // RX_BUFFER_SIZE
+    int queueSize() const { return mQueueSize; }
+    void setQueueSize(int commands) { mQueueSize = qMax(commands, 1); } // BUFSIZE
+    
+    int linesReceived() const { return mReceived; }
+    int commandsExecuted() const { return mExecuted; }
+    int resendsRequested() const { return mResends; }
+    int bytesDropped() const { return mDropped; } // Received on a full buffer
+
+signals:
+    void commandExecuted(const QByteArray &command);
+
+private slots:
+    void readMaster();
+    void execute();
+
+private:
+    void processInput();
+    bool receive(const QByteArray &line); // False if a resend was asked for
+    void requestResend(const QByteArray &error);
+    void reply(const QByteArray &text);
+    
+    int mMaster;
+    int mSlave; // Kept open, so the master does not hang up
+    QString mPortName;
+    QSocketNotifier *mNotifier;
+    QTimer *mTimer;
+    QByteArray mInput; // The receive buffer
+    QList<QByteArray> mQueue;
+    
+    int mCommandTime;
+    int mErrorInterval;
+    int mBufferSize;
+    int mQueueSize;
+    int mExpected; // The next line number
+    
+    int mReceived;
+    int mExecuted;
+    int mResends;
+    int mDropped;
+};
+
+#endif // GPRINTERSIMULATOR_H
@@ -0,0 +1,257 @@
+#include "gsender.h"
+
+#include "gcode.h"
+
+#include <QIODevice>
+
+GSender::GSender(const GCode *gcode, QObject *parent)
+    : QObject(parent),
+      mGCode(gcode),
+      mDevice(NULL),
+      mFlowControl(OkCounting),
+      mWindow(4),
+      mBufferSize(127),
+      mSending(false),
+      mNextLine(0),
+      mLastLine(-1),
+      mNextNumber(0),
+      mInFlightBytes(0),
+      mResendNumber(-1),
+      mIgnoredResends(0),
+      mSkippedOks(0),
+      mElapsed(0),
+      mLinesCount(0),
+      mLinesSent(0),
+      mLinesAcknowledged(0),
+      mResends(0),
+      mBytesSent(0),
+      mLatencySum(0),
+      mLatencyMax(0)
+{
+}
+
+bool GSender::start(QIODevice *device, int firstLine, int lastLine)
+{
+    if (mSending || !device->isOpen()) {
+        return false;
+    }
+    
+    mDevice = device;
+    mNextLine = qMax(firstLine, 0);
+    mLastLine = lastLine < 0 ? mGCode->linesCount() - 1 : qMin(lastLine, mGCode->linesCount() - 1);
+    mNextNumber = 1;
+    mInFlight.clear();
+    mInFlightBytes = 0;
+    mResendQueue.clear();
+    mResendNumber = -1;
+    mIgnoredResends = 0;
+    mSkippedOks = 0;
+    
+    mLinesCount = 0;
+    for (int l = mNextLine; l <= mLastLine; ++l) {
+        if (!mGCode->command(l).isEmpty()) {
+            ++mLinesCount;
+        }
+    }
+    mLinesSent = 0;
+    mLinesAcknowledged = 0;
+    mResends = 0;
+    mBytesSent = 0;
+    mLatencySum = 0;
+    mLatencyMax = 0;
+    mElapsed = 0;
+    
+    mSending = true;
+    mClock.start();
+    connect(mDevice, SIGNAL(readyRead()), this, SLOT(readResponses()));
+    
+    // The firmware counts from the reset line
+    Command reset = {0, QByteArray("M110 N0"), 0};
+    send(reset);
+    fill();
+    return true;
+}
+
+void GSender::stop()
+{
+    if (!mSending) {
+        return;
+    }
+    
+    disconnect(mDevice, SIGNAL(readyRead()), this, SLOT(readResponses()));
+    mSending = false;
+    mElapsed = mClock.nsecsElapsed() / 1000;
+}
+
+double GSender::throughput() const
+{
+    qint64 elapsed = mSending ? mClock.nsecsElapsed() / 1000 : mElapsed;
+    return elapsed > 0 ? mBytesSent * 1e6 / elapsed : 0.0;
+}
+
+double GSender::linesPerSecond() const
+{
+    qint64 elapsed = mSending ? mClock.nsecsElapsed() / 1000 : mElapsed;
+    return elapsed > 0 ? mLinesAcknowledged * 1e6 / elapsed : 0.0;
+}
+
+double GSender::averageLatency() const
+{
+    return mLinesAcknowledged > 0 ? mLatencySum / 1000.0 / mLinesAcknowledged : 0.0;
+}
+
+double GSender::maxLatency() const
+{
+    return mLatencyMax / 1000.0;
+}
+
+QByteArray GSender::numbered(int number, const QByteArray &command)
+{
+    QByteArray line = "N" + QByteArray::number(number) + " " + command;
+    return line + "*" + QByteArray::number(GCodeLine::checksum(line));
+}
+
+void GSender::readResponses()
+{
+    while (mSending && mDevice->canReadLine()) {
+        QByteArray response = mDevice->readLine().trimmed();
+        if (response.startsWith("ok")) {
+            if (mSkippedOks > 0) {
+                --mSkippedOks;
+            } else {
+                acknowledge();
+            }
+        
+        } else if (response.startsWith("Resend:") || response.startsWith("rs ")) {
+            int start = response.indexOf(response.at(0) == 'R' ? ':' : ' ') + 1;
+            resend(response.mid(start).trimmed().toInt());
+        
+        } else if (!response.isEmpty()) {
+            emit message(QString::fromLatin1(response));
+        }
+    }
+    
+    if (mSending) {
+        fill();
+    }
+}
+
+// Resent lines go first, with their numbers
+void GSender::fill()
+{
+    while (mSending) {
+        if (!mResendQueue.isEmpty()) {
+            if (!fits(mResendQueue.first())) {
+                break;
+            }
+            send(mResendQueue.takeFirst());
+            continue;
+        }
+        
+        while (mNextLine <= mLastLine && mGCode->command(mNextLine).isEmpty()) {
+            ++mNextLine;
+        }
+        if (mNextLine > mLastLine) {
+            break;
+        }
+        
+        Command command = {mNextNumber, mGCode->command(mNextLine).toLatin1(), 0};
+        if (!fits(command)) {
+            break;
+        }
+        send(command);
+        ++mNextNumber;
+        ++mNextLine;
+        ++mLinesSent;
+    }
+    
+    finish();
+}
+
+bool GSender::fits(const Command &command) const
+{
+    if (mInFlight.isEmpty()) {
+        return true;
+    }
+    if (mFlowControl == CharacterCounting) {
+        return mInFlightBytes + numbered(command.number, command.data).size() + 1 <= mBufferSize;
+    }
+    return mInFlight.size() < mWindow;
+}
+
+void GSender::send(const Command &command)
+{
+    QByteArray line = numbered(command.number, command.data);
+    line.append('\n');
+    mDevice->write(line);
+    
+    Command sent = command;
+    sent.sentAt = mClock.nsecsElapsed() / 1000;
+    mInFlight.append(sent);
+    mInFlightBytes += line.size();
+    mBytesSent += line.size();
+}
+
+void GSender::acknowledge()
+{
+    if (mInFlight.isEmpty()) {
+        return;
+    }
+    
+    Command command = mInFlight.takeFirst();
+    mInFlightBytes -= numbered(command.number, command.data).size() + 1;
+    
+    // The resent line is in, the firmware may have dropped stale lines
+    // without answering them, so further resends are genuine
+    if (mResendNumber >= 0 && command.number >= mResendNumber) {
+        mResendNumber = -1;
+        mIgnoredResends = 0;
+    }
+    
+    qint64 latency = mClock.nsecsElapsed() / 1000 - command.sentAt;
+    mLatencySum += latency;
+    mLatencyMax = qMax(mLatencyMax, latency);
+    
+    if (command.number > 0) {
+        ++mLinesAcknowledged;
+        emit progress(mLinesAcknowledged, mLinesCount);
+    }
+}
+
+void GSender::resend(int number)
+{
+    // Every ignored request comes with an ok
+    ++mSkippedOks;
+    if (number == mResendNumber && mIgnoredResends > 0) {
+        --mIgnoredResends;
+        return;
+    }
+    
+    int i = 0;
+    while (i < mInFlight.size() && mInFlight.at(i).number != number) {
+        ++i;
+    }
+    if (i == mInFlight.size()) {
+        emit message(QString("Resend of a line not in flight: %1").arg(number));
+        return;
+    }
+    
+    QList<Command> stale = mInFlight.mid(i);
+    mInFlight.erase(mInFlight.begin() + i, mInFlight.end());
+    foreach (const Command &command, stale) {
+        mInFlightBytes -= numbered(command.number, command.data).size() + 1;
+    }
+    mResendQueue = stale + mResendQueue;
+    
+    mResendNumber = number;
+    mIgnoredResends = stale.size() - 1;
+    ++mResends;
+}
+
+void GSender::finish()
+{
+    if (mSending && mNextLine > mLastLine && mResendQueue.isEmpty() && mInFlight.isEmpty()) {
+        stop();
+        emit finished();
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef GSENDER_H
+#define GSENDER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QElapsedTimer>
+
+class QIODevice;
+class GCode;
+
+// Streams the commands of a GCode to a printer with line numbers and
+// checksums. Commands are sent ahead of their "ok" as long as they fit
+// the window: a number of commands, or the bytes of the firmware receive
+// buffer when counting characters. Resend requests rewind to the line
+// asked for; the stale lines sent after it may be answered with resends
+// of the same line, which are ignored until the resent line is
+// acknowledged. Any QIODevice will do; the tty device
+// and the simulated printer on a pty are built on unix only.
+class GSender : public QObject
+{
+    Q_OBJECT
+public:
+    enum FlowControl {
+        OkCounting = 0,
+        CharacterCounting
+    };
+    
+    explicit GSender(const GCode *gcode, QObject *parent = 0);
+    
+    FlowControl flowControl() const { return mFlowControl; }
+    void setFlowControl(FlowControl flowControl) { mFlowControl = flowControl; }
+    int window() const { return mWindow; }
+    void setWindow(int commands) { mWindow = qMax(commands, 1); } // Ok counting
+    int bufferSize() const { return mBufferSize; }
+    void setBufferSize(int bytes) { mBufferSize = qMax(bytes, 1); } // Character counting
+    
+    bool start(QIODevice *device, int firstLine = 0, int lastLine = -1); // Starts with M110 N0
+    void stop();
+    bool isSending() const { return mSending; }
+    
+    // Statistics of the last start
+    int linesCount() const { return mLinesCount; }
+    int linesSent() const { return mLinesSent; }
+    int linesAcknowledged() const { return mLinesAcknowledged; }
+    int resends() const { return mResends; }
+    qint64 bytesSent() const { return mBytesSent; }
+    double throughput() const; // Bytes per second
+    double linesPerSecond() const;
+    double averageLatency() const; // Milliseconds from sending a line to its ok
+    double maxLatency() const;
+    
+    static QByteArray numbered(int number, const QByteArray &command); // N<number> <command>*<checksum>
+
+signals:
+    void progress(int acknowledged, int count);
+    void message(const QString &text); // Firmware output other than ok and resends
+    void finished();
+
+private slots:
+    void readResponses();
+
+private:
+    struct Command {
+        int number;
+        QByteArray data;
+        qint64 sentAt; // Microseconds
+    };
+    
+    void fill();
+    bool fits(const Command &command) const;
+    void send(const Command &command);
+    void acknowledge();
+    void resend(int number);
+    void finish();
+    
+    const GCode *mGCode;
+    QIODevice *mDevice;
+    FlowControl mFlowControl;
+    int mWindow;
+    int mBufferSize;
+    
+    bool mSending;
+    int mNextLine;
+    int mLastLine;
+    int mNextNumber;
+    QList<Command> mInFlight;
+    int mInFlightBytes;
+    QList<Command> mResendQueue;
+    int mResendNumber;
+    int mIgnoredResends; // Stale lines still to be answered, at most
+    int mSkippedOks;     // Oks of the resend requests
+    
+    QElapsedTimer mClock;
+    qint64 mElapsed; // Microseconds, when finished
+    int mLinesCount;
+    int mLinesSent;
+    int mLinesAcknowledged;
+    int mResends;
+    qint64 mBytesSent;
+    qint64 mLatencySum;
+    qint64 mLatencyMax;
+};
+
+#endif // GSENDER_H
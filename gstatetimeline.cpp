@@ -0,0 +1,105 @@
+#include "gstatetimeline.h"
+
+#include <QtAlgorithms>
+
+GStateTimeline::GStateTimeline()
+    : mCursor(0)
+{
+}
+
+GStateTimeline::GStateTimeline(const GStateTimeline &other)
+    : mMoves(other.mMoves),
+      mStates(other.mStates),
+      mCursor(0)
+{
+}
+
+GStateTimeline &GStateTimeline::operator=(const GStateTimeline &other)
+{
+    mMoves = other.mMoves;
+    mStates = other.mStates;
+    mCursor.store(0);
+    return *this;
+}
+
+void GStateTimeline::clear()
+{
+    mMoves.clear();
+    mStates.clear();
+    mCursor.store(0);
+}
+
+void GStateTimeline::append(int move, const GMoveModifiers &state)
+{
+    Q_ASSERT(mMoves.isEmpty() || move > mMoves.last());
+    const GMoveModifiers &last = mStates.isEmpty() ? mDefault : mStates.last();
+    if (mMoves.isEmpty() || difference(last, state) != 0) {
+        mMoves.append(move);
+        mStates.append(state);
+    }
+}
+
+void GStateTimeline::squeeze()
+{
+    mMoves.squeeze();
+    mStates.squeeze();
+}
+
+const GMoveModifiers &GStateTimeline::at(int move) const
+{
+    int i = indexAt(move);
+    return i < 0 ? mDefault : mStates.at(i);
+}
+
+int GStateTimeline::indexAt(int move) const
+{
+    int size = mMoves.size();
+    if (size == 0 || move < mMoves.first()) {
+        return -1;
+    }
+    
+    // Renderers and exporters walk the moves in order, so try the cached
+    // change and its successor before falling back to the binary search
+    int c = mCursor.load();
+    if (c < size && mMoves.at(c) <= move) {
+        if (c + 1 == size || move < mMoves.at(c + 1)) {
+            return c;
+        }
+        if (c + 2 == size || move < mMoves.at(c + 2)) {
+            mCursor.store(c + 1);
+            return c + 1;
+        }
+    }
+    
+    c = int(qUpperBound(mMoves.constBegin(), mMoves.constEnd(), move) - mMoves.constBegin()) - 1;
+    mCursor.store(c);
+    return c;
+}
+
+QVector<int> GStateTimeline::changes(int fields) const
+{
+    QVector<int> moves;
+    for (int i = 0; i < mMoves.size(); ++i) {
+        const GMoveModifiers &previous = i == 0 ? mDefault : mStates.at(i - 1);
+        if (difference(previous, mStates.at(i)) & fields) {
+            moves.append(mMoves.at(i));
+        }
+    }
+    return moves;
+}
+
+int GStateTimeline::difference(const GMoveModifiers &a, const GMoveModifiers &b)
+{
+    int fields = 0;
+    if (a.extruderShift != b.extruderShift) fields |= ExtruderShift;
+    if (a.speedFactor != b.speedFactor) fields |= SpeedFactor;
+    if (a.extrudeFactor != b.extrudeFactor) fields |= ExtrudeFactor;
+    if (a.extrusionIsAbsolute != b.extrusionIsAbsolute) fields |= ExtrusionMode;
+    if (a.bedTemp != b.bedTemp) fields |= BedTemperature;
+    if (a.extTemp != b.extTemp) fields |= ExtruderTemperature;
+    if (a.fanSpeed != b.fanSpeed) fields |= FanSpeed;
+    if (a.positioningIsAbsolute != b.positioningIsAbsolute) fields |= PositioningMode;
+    if (a.acceleration != b.acceleration) fields |= Acceleration;
+    if (a.retractLength != b.retractLength || a.recoverExtraLength != b.recoverExtraLength) fields |= Retraction;
+    return fields;
+}
@@ -0,0 +1,53 @@
+#ifndef GSTATETIMELINE_H
+#define GSTATETIMELINE_H
+
+#include <QVector>
+#include <QAtomicInt>
+
+#include "gmove.h"
+
+// Run-length log of the modal printer state. An entry is stored only
+// for the moves where GMoveModifiers differ from the previous move.
+class GStateTimeline
+{
+public:
+    enum Field {
+        ExtruderShift = 0x1,
+        SpeedFactor = 0x2,
+        ExtrudeFactor = 0x4,
+        ExtrusionMode = 0x8,
+        BedTemperature = 0x10,
+        ExtruderTemperature = 0x20,
+        FanSpeed = 0x40,
+        PositioningMode = 0x80,
+        Acceleration = 0x100,
+        Retraction = 0x200
+    };
+    
+    GStateTimeline();
+    GStateTimeline(const GStateTimeline &other);
+    GStateTimeline& operator=(const GStateTimeline &other);
+    
+    void clear();
+    void append(int move, const GMoveModifiers &state);
+    void squeeze();
+    
+    const GMoveModifiers& at(int move) const;
+    int indexAt(int move) const; // Index of the change in effect at the move
+    
+    int changesCount() const { return mMoves.size(); }
+    int changeMove(int i) const { return mMoves.at(i); }
+    const GMoveModifiers& changeState(int i) const { return mStates.at(i); }
+    QVector<int> changes(int fields) const; // Moves where any of the fields changed
+    
+    static int difference(const GMoveModifiers &a, const GMoveModifiers &b);
+    
+private:
+    QVector<int> mMoves;
+    QVector<GMoveModifiers> mStates;
+    GMoveModifiers mDefault;
+    
+    mutable QAtomicInt mCursor; // Last looked up change, sequential lookups are O(1)
+};
+
+#endif // GSTATETIMELINE_H
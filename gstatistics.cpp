@@ -0,0 +1,201 @@
+#include "gstatistics.h"
+
+#include <QtConcurrent>
+
+GMoveStatistics::GMoveStatistics()
+    : moves(0),
+      extrusions(0),
+      retracts(0),
+      retractLength(0.0)
+{
+    histograms.append(GHistogram(0.0, 500.0, 100)); // Feedrate, mm/s
+    histograms.append(GHistogram(0.0, 0.2, 100));   // Flow
+    histograms.append(GHistogram(0.0, 100.0, 100)); // Length
+    histograms.append(GHistogram(0.0, 10.0, 100));  // Retract length
+}
+
+void GMoveStatistics::add(const GMove &move, float feedrate)
+{
+    ++moves;
+    
+    switch (move.type()) {
+    case GMove::Extrusion:
+        ++extrusions;
+        histograms[Flow].add(move.flowE());
+        break;
+    
+    case GMove::Suck:
+    case GMove::DestringSuck:
+        ++retracts;
+        retractLength += qAbs(move.dE());
+        histograms[RetractLength].add(qAbs(move.dE()));
+        break;
+    
+    default:
+        break;
+    }
+    
+    if (move.distance() > 0) {
+        histograms[Feedrate].add(feedrate);
+        histograms[Length].add(move.distance());
+    }
+}
+
+void GMoveStatistics::merge(const GMoveStatistics &other)
+{
+    moves += other.moves;
+    extrusions += other.extrusions;
+    retracts += other.retracts;
+    retractLength += other.retractLength;
+    for (int i = 0; i < HistogramsCount; ++i) {
+        histograms[i].merge(other.histograms.at(i));
+    }
+}
+
+GStatistics::GStatistics(GNavigator *navigator)
+    : mNavigator(navigator),
+      mRevision(-1),
+      mIncremental(false),
+      mZ(0.0),
+      mUnits(Units::mmPerS)
+{
+}
+
+GStatistics::~GStatistics()
+{
+    mNavigator->gcode()->removeObserver(this);
+}
+
+void GStatistics::setHistogram(GMoveStatistics::Histogram histogram, double min, double max, int bins)
+{
+    Q_ASSERT(histogram >= 0 && histogram < GMoveStatistics::HistogramsCount);
+    mPrototype.histograms[histogram] = GHistogram(min, max, bins);
+    invalidate();
+}
+
+void GStatistics::setIncremental(bool incremental)
+{
+    mIncremental = incremental;
+    if (incremental) {
+        mNavigator->gcode()->addObserver(this);
+    } else {
+        mNavigator->gcode()->removeObserver(this);
+    }
+}
+
+bool GStatistics::update()
+{
+    GCode *gcode = mNavigator->gcode();
+    if (mRevision == gcode->revision()) {
+        return false;
+    }
+    
+    GNavigatorItem *root = mNavigator->root();
+    int size = root->childCount();
+    
+    QVector<Range> ranges(size);
+    for (int i = 0; i < size; ++i) {
+        GNavigatorItem *item = root->child(i);
+        int first = gcode->lineToMoveForward(item->firstLine());
+        if (first >= 0 && gcode->moveToLine(first) <= item->lastLine()) {
+            ranges[i].firstMove = first;
+            ranges[i].lastMove = gcode->lineToMoveBackward(item->lastLine());
+        }
+    }
+    
+    // Every layer has its own partial result
+    mLayers = QVector<GMoveStatistics>(size, mPrototype);
+    GMoveStatistics *layers = mLayers.data();
+    QVector<int> rows(size);
+    for (int i = 0; i < size; ++i) {
+        rows[i] = i;
+    }
+    QtConcurrent::blockingMap(rows, [this, &ranges, layers](int row) {
+        collect(ranges.at(row), layers + row);
+    });
+    
+    mergeLayers();
+    mRevision = gcode->revision();
+    return true;
+}
+
+void GStatistics::invalidate()
+{
+    mRevision = -1;
+}
+
+const GMoveStatistics &GStatistics::layer(int row) const
+{
+    Q_ASSERT(row >= 0 && row < mLayers.size());
+    return mLayers.at(row);
+}
+
+void GStatistics::beginRead(const GCode *gcode)
+{
+    mLayers.clear();
+    mLayers.append(mPrototype);
+    mZ = 0.0;
+    mUnits = gcode->speedUnits();
+    mRevision = -1;
+}
+
+// Layers start where Z changes, as the GNavigator layers do
+void GStatistics::move(int m, int line, const GMove &move, const GMoveModifiers &mods)
+{
+    Q_UNUSED(m);
+    Q_UNUSED(line);
+    
+    if (qAbs(move.Z() - mZ) > Layers::zTolerance) {
+        mZ = move.Z();
+        mLayers.append(mPrototype);
+    }
+    
+    mLayers.last().add(move, feedrate(move, mods, mUnits));
+}
+
+void GStatistics::endRead(const GCode *gcode)
+{
+    if (gcode->linesCount() == 0) {
+        mLayers.clear();
+    }
+    
+    mergeLayers();
+    mRevision = gcode->revision();
+}
+
+// Walks the state timeline along with the moves, as GCode::exportVertices() does
+void GStatistics::collect(const GStatistics::Range &range, GMoveStatistics *statistics) const
+{
+    if (range.lastMove < range.firstMove) {
+        return;
+    }
+    
+    const GCode *gcode = mNavigator->gcode();
+    const GStateTimeline &timeline = gcode->timeline();
+    int c = timeline.indexAt(range.firstMove);
+    int next = c + 1 < timeline.changesCount() ? timeline.changeMove(c + 1) : gcode->movesCount();
+    GMoveModifiers mods = timeline.at(range.firstMove);
+    for (int m = range.firstMove; m <= range.lastMove; ++m) {
+        if (m == next) {
+            mods = timeline.changeState(++c);
+            next = c + 1 < timeline.changesCount() ? timeline.changeMove(c + 1) : gcode->movesCount();
+        }
+        
+        GMove move = gcode->move(m);
+        statistics->add(move, feedrate(move, mods, gcode->speedUnits()));
+    }
+}
+
+void GStatistics::mergeLayers()
+{
+    mTotal = mPrototype;
+    foreach (const GMoveStatistics &layer, mLayers) {
+        mTotal.merge(layer);
+    }
+}
+
+float GStatistics::feedrate(const GMove &move, const GMoveModifiers &mods, Units::SpeedUnits units)
+{
+    float f = move.F() * mods.speedFactor;
+    return units == Units::mmPerMin ? f : f / 60;
+}
@@ -0,0 +1,80 @@
+#ifndef GSTATISTICS_H
+#define GSTATISTICS_H
+
+#include <QVector>
+
+#include "ghistogram.h"
+#include "gmoveobserver.h"
+#include "gnavigator.h"
+
+// Statistics of a range of moves. Statistics of consecutive ranges are merged.
+struct GMoveStatistics {
+    enum Histogram {
+        Feedrate = 0,  // Effective feedrate of the moves with a distance
+        Flow,          // Effective flow of the extrusions
+        Length,        // Distance of the moves with a distance
+        RetractLength, // Length of the retracts
+        HistogramsCount
+    };
+    
+    GMoveStatistics();
+    
+    void add(const GMove &move, float feedrate);
+    void merge(const GMoveStatistics &other);
+    
+    int moves;
+    int extrusions;
+    int retracts;
+    double retractLength;
+    QVector<GHistogram> histograms;
+};
+
+// Per layer and per file move statistics, a sibling of the layer
+// GNavigatorItemInfo. Layers are computed on the thread pool, or
+// collected while the GCode reads the data when incremental.
+class GStatistics : public GMoveObserver
+{
+public:
+    explicit GStatistics(GNavigator *navigator);
+    ~GStatistics();
+    
+    void setHistogram(GMoveStatistics::Histogram histogram, double min, double max, int bins);
+    
+    bool isIncremental() const { return mIncremental; }
+    void setIncremental(bool incremental); // Applies to the next read
+    
+    bool update(); // Recomputes the statistics if the data has changed
+    void invalidate();
+    
+    int layersCount() const { return mLayers.size(); }
+    const GMoveStatistics& layer(int row) const; // Of the layer at the row of the navigator root
+    const GMoveStatistics& total() const { return mTotal; }
+    
+    void beginRead(const GCode *gcode);
+    void move(int m, int line, const GMove &move, const GMoveModifiers &mods);
+    void endRead(const GCode *gcode);
+
+private:
+    struct Range {
+        Range() : firstMove(0), lastMove(-1) {}
+        int firstMove;
+        int lastMove;
+    };
+    
+    void collect(const Range &range, GMoveStatistics *statistics) const;
+    void mergeLayers();
+    static float feedrate(const GMove &move, const GMoveModifiers &mods, Units::SpeedUnits units);
+    
+    GNavigator *mNavigator;
+    GMoveStatistics mPrototype; // Empty, with the histogram bins
+    QVector<GMoveStatistics> mLayers;
+    GMoveStatistics mTotal;
+    int mRevision;
+    bool mIncremental;
+    
+    // Read state
+    double mZ;
+    Units::SpeedUnits mUnits;
+};
+
+#endif // GSTATISTICS_H
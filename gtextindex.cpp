@@ -0,0 +1,320 @@
+#include "gtextindex.h"
+
+#include "gcode.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+
+static const int ChunkLines = 16384; // Lines indexed by one task
+
+GTextIndex::GTextIndex(const GCode *gcode)
+    : mGCode(gcode),
+      mBuilt(false)
+{
+}
+
+void GTextIndex::build()
+{
+    clear();
+    
+    QVector<int> chunks;
+    for (int first = 0; first < mGCode->linesCount(); first += ChunkLines) {
+        chunks.append(first);
+    }
+    
+    // Chunks are merged in line order, so the postings stay sorted
+    QVector<Postings> parts(chunks.size());
+    QVector<int> indices(chunks.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        indices[i] = i;
+    }
+    QtConcurrent::blockingMap(indices, [this, &chunks, &parts](int i) {
+        int first = chunks.at(i);
+        parts[i] = buildChunk(first, qMin(first + ChunkLines, mGCode->linesCount()) - 1);
+    });
+    
+    for (int i = 0; i < parts.size(); ++i) {
+        const Postings &part = parts.at(i);
+        for (QHash<quint32, QVector<int> >::const_iterator it = part.trigrams.constBegin(); it != part.trigrams.constEnd(); ++it) {
+            mPostings.trigrams[it.key()] += it.value();
+        }
+        for (QHash<QString, QVector<int> >::const_iterator it = part.codes.constBegin(); it != part.codes.constEnd(); ++it) {
+            mPostings.codes[it.key()] += it.value();
+        }
+        parts[i] = Postings();
+    }
+    
+    mBuilt = true;
+}
+
+void GTextIndex::clear()
+{
+    mPostings = Postings();
+    mBuilt = false;
+}
+
+GTextIndex::Postings GTextIndex::buildChunk(int firstLine, int lastLine) const
+{
+    Postings postings;
+    for (int l = firstLine; l <= lastLine; ++l) {
+        QString text = mGCode->text(l);
+        const QChar *c = text.constData();
+        for (int i = 0; i + 3 <= text.size(); ++i) {
+            QVector<int> &lines = postings.trigrams[trigram(c + i)];
+            if (lines.isEmpty() || lines.last() != l) {
+                lines.append(l);
+            }
+        }
+        
+        if (mGCode->lineType(l) == GCodeLine::Command) {
+            postings.codes[mGCode->code(l)].append(l);
+        }
+    }
+    
+    return postings;
+}
+
+QVector<int> GTextIndex::find(const QString &text) const
+{
+    QVector<int> lines;
+    QVector<int> found;
+    bool filtered = mBuilt && candidates(QStringList(text), &found);
+    int count = filtered ? found.size() : mGCode->linesCount();
+    
+    for (int i = 0; i < count; ++i) {
+        int l = filtered ? found.at(i) : i;
+        if (mGCode->text(l).contains(text)) {
+            lines.append(l);
+        }
+    }
+    
+    return lines;
+}
+
+QVector<int> GTextIndex::find(const QRegExp &rx) const
+{
+    QVector<int> lines;
+    QVector<int> found;
+    bool filtered = mBuilt && candidates(requiredLiterals(rx), &found);
+    int count = filtered ? found.size() : mGCode->linesCount();
+    
+    QRegExp re(rx);
+    for (int i = 0; i < count; ++i) {
+        int l = filtered ? found.at(i) : i;
+        if (re.indexIn(mGCode->text(l)) >= 0) {
+            lines.append(l);
+        }
+    }
+    
+    return lines;
+}
+
+QVector<int> GTextIndex::linesWithCode(const QString &code) const
+{
+    if (mBuilt) {
+        return mPostings.codes.value(code);
+    }
+    
+    QVector<int> lines;
+    for (int l = 0; l < mGCode->linesCount(); ++l) {
+        if (mGCode->lineType(l) == GCodeLine::Command && mGCode->code(l) == code) {
+            lines.append(l);
+        }
+    }
+    
+    return lines;
+}
+
+QList<QPair<int, int> > GTextIndex::ranges(const QVector<int> &lines)
+{
+    QList<QPair<int, int> > runs;
+    foreach (int l, lines) {
+        if (!runs.isEmpty() && runs.last().second + 1 == l) {
+            runs.last().second = l;
+        } else {
+            runs.append(qMakePair(l, l));
+        }
+    }
+    
+    return runs;
+}
+
+// Lines containing all the trigrams of the literals. Returns false if
+// there is no trigram to filter with.
+bool GTextIndex::candidates(const QStringList &literals, QVector<int> *lines) const
+{
+    QList<const QVector<int>*> postings;
+    foreach (const QString &literal, literals) {
+        for (int i = 0; i + 3 <= literal.size(); ++i) {
+            QHash<quint32, QVector<int> >::const_iterator it = mPostings.trigrams.constFind(trigram(literal.constData() + i));
+            if (it == mPostings.trigrams.constEnd()) {
+                lines->clear();
+                return true;
+            }
+            postings.append(&it.value());
+        }
+    }
+    
+    if (postings.isEmpty()) {
+        return false;
+    }
+    
+    // Starting from the shortest list, look the lines up in the others
+    std::sort(postings.begin(), postings.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+    
+    *lines = *postings.first();
+    for (int p = 1; p < postings.size() && !lines->isEmpty(); ++p) {
+        const QVector<int> &other = *postings.at(p);
+        QVector<int> common;
+        foreach (int l, *lines) {
+            if (std::binary_search(other.constBegin(), other.constEnd(), l)) {
+                common.append(l);
+            }
+        }
+        *lines = common;
+    }
+    
+    return true;
+}
+
+// Literal strings every match of the expression contains. Conservative:
+// alternations, lookaheads and case insensitive patterns give none.
+QStringList GTextIndex::requiredLiterals(const QRegExp &rx)
+{
+    QString p = rx.pattern();
+    if (rx.caseSensitivity() == Qt::CaseInsensitive) {
+        return QStringList();
+    }
+    if (rx.patternSyntax() == QRegExp::FixedString) {
+        return QStringList(p);
+    }
+    if ((rx.patternSyntax() != QRegExp::RegExp && rx.patternSyntax() != QRegExp::RegExp2)
+            || p.contains('|') || p.contains("(?")) {
+        return QStringList();
+    }
+    
+    QList<QStringList> groups; // Literals of the enclosing groups
+    QStringList literals;
+    QString run;
+    
+    // Skips a quantifier at i and tells if it allows no occurrence
+    auto skipQuantifier = [&p](int *i, bool *optional) {
+        *optional = false;
+        if (*i >= p.size()) {
+            return false;
+        }
+        QChar q = p.at(*i);
+        if (q == '?' || q == '*') {
+            *optional = true;
+            ++*i;
+        } else if (q == '+') {
+            ++*i;
+        } else if (q == '{') {
+            *optional = true;
+            while (*i < p.size() && p.at(*i) != '}') {
+                ++*i;
+            }
+            ++*i;
+        } else {
+            return false;
+        }
+        return true;
+    };
+    
+    auto flush = [&run, &literals]() {
+        if (!run.isEmpty()) {
+            literals.append(run);
+            run.clear();
+        }
+    };
+    
+    int i = 0;
+    while (i < p.size()) {
+        QChar c = p.at(i);
+        bool literal = false;
+        
+        if (c == '\\' && i + 1 < p.size()) {
+            QChar e = p.at(i + 1);
+            i += 2;
+            if (!e.isLetterOrNumber()) {
+                c = e;
+                literal = true;
+            } else {
+                // Character classes, references and character codes
+                flush();
+                if (e == 'x' || e == 'u' || e == '0' || e.isDigit()) {
+                    while (i < p.size() && (p.at(i).isDigit() || (e != '0' && QString("abcdefABCDEF").contains(p.at(i))))) {
+                        ++i;
+                    }
+                }
+            }
+        
+        } else if (c == '[') {
+            flush();
+            ++i;
+            if (i < p.size() && p.at(i) == '^') ++i;
+            if (i < p.size() && p.at(i) == ']') ++i;
+            while (i < p.size() && p.at(i) != ']') {
+                i += p.at(i) == '\\' ? 2 : 1;
+            }
+            ++i;
+        
+        } else if (c == '(') {
+            flush();
+            groups.append(literals);
+            literals.clear();
+            ++i;
+            continue;
+        
+        } else if (c == ')') {
+            flush();
+            ++i;
+            bool optional = false;
+            skipQuantifier(&i, &optional);
+            QStringList inner = literals;
+            literals = groups.isEmpty() ? QStringList() : groups.takeLast();
+            if (!optional) {
+                literals += inner;
+            }
+            continue;
+        
+        } else if (c == '.' || c == '^' || c == '$' || c == '?' || c == '*' || c == '+' || c == '{') {
+            flush();
+            bool optional = false;
+            if (!skipQuantifier(&i, &optional)) {
+                ++i;
+            }
+            continue;
+        
+        } else {
+            literal = true;
+            ++i;
+        }
+        
+        bool optional = false;
+        bool quantified = skipQuantifier(&i, &optional);
+        if (literal && !optional) {
+            run.append(c);
+        }
+        if (quantified) {
+            flush();
+        }
+    }
+    
+    flush();
+    return literals;
+}
+
+quint32 GTextIndex::trigram(const QChar *c)
+{
+    // Characters past Latin-1 share a key, the candidates are verified anyway
+    quint32 key = 0;
+    for (int i = 0; i < 3; ++i) {
+        ushort u = c[i].unicode();
+        key = (key << 8) | (u < 0xff ? u : 0xff);
+    }
+    
+    return key;
+}
@@ -0,0 +1,51 @@
+#ifndef GTEXTINDEX_H
+#define GTEXTINDEX_H
+
+#include <QHash>
+#include <QVector>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QRegExp>
+
+class GCode;
+
+// Search index over the lines of a GCode: the lines containing every
+// trigram of the text and the command lines of every code (G1, M600...).
+// Candidate lines from the trigrams are verified against the text, so
+// the cost of a query follows the number of candidates, not the file size.
+// Queries fall back to scanning all the lines when the index is not built.
+class GTextIndex
+{
+public:
+    explicit GTextIndex(const GCode *gcode);
+    
+    void build(); // Indexes chunks of lines on the thread pool
+    void clear();
+    bool isBuilt() const { return mBuilt; }
+    
+    // Matching lines in ascending order
+    QVector<int> find(const QString &text) const;
+    QVector<int> find(const QRegExp &rx) const;
+    QVector<int> linesWithCode(const QString &code) const;
+    
+    static QList<QPair<int, int> > ranges(const QVector<int> &lines); // Runs of consecutive lines
+
+private:
+    struct Postings {
+        QHash<quint32, QVector<int> > trigrams;
+        QHash<QString, QVector<int> > codes;
+    };
+    
+    Postings buildChunk(int firstLine, int lastLine) const;
+    bool candidates(const QStringList &literals, QVector<int> *lines) const;
+    static QStringList requiredLiterals(const QRegExp &rx);
+    static quint32 trigram(const QChar *c);
+    
+    const GCode *mGCode;
+    bool mBuilt;
+    Postings mPostings;
+};
+
+#endif // GTEXTINDEX_H
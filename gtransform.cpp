@@ -0,0 +1,122 @@
+#include "gtransform.h"
+
+#include <QtMath>
+#include <limits>
+
+GTransform::GTransform()
+    : mM11(1.0), mM12(0.0), mM21(0.0), mM22(1.0),
+      mDX(0.0), mDY(0.0),
+      mZScale(1.0), mZOffset(0.0),
+      mFeedrateScale(1.0),
+      mFeedrateMin(0.0),
+      mFeedrateMax(std::numeric_limits<double>::max()),
+      mExtrusionScale(1.0)
+{
+}
+
+GTransform &GTransform::translate(double dx, double dy, double dz)
+{
+    multiply(1.0, 0.0, 0.0, 1.0, dx, dy);
+    mZOffset += dz;
+    return *this;
+}
+
+GTransform &GTransform::scale(double sx, double sy, double sz)
+{
+    multiply(sx, 0.0, 0.0, sy, 0.0, 0.0);
+    mZScale *= sz;
+    mZOffset *= sz;
+    return *this;
+}
+
+GTransform &GTransform::rotate(double degrees, double cx, double cy)
+{
+    double a = qDegreesToRadians(degrees);
+    double c = qCos(a);
+    double s = qSin(a);
+    multiply(c, -s, s, c, cx - c * cx + s * cy, cy - s * cx - c * cy);
+    return *this;
+}
+
+// Scaling the clamped feedrate is clamping the scaled one to scaled bounds
+GTransform &GTransform::scaleFeedrate(double factor)
+{
+    Q_ASSERT(factor > 0.0);
+    mFeedrateScale *= factor;
+    mFeedrateMin *= factor;
+    if (mFeedrateMax < std::numeric_limits<double>::max()) {
+        mFeedrateMax *= factor;
+    }
+    return *this;
+}
+
+GTransform &GTransform::clampFeedrate(double min, double max)
+{
+    Q_ASSERT(min <= max);
+    mFeedrateMin = qBound(min, mFeedrateMin, max);
+    mFeedrateMax = qBound(min, mFeedrateMax, max);
+    return *this;
+}
+
+GTransform &GTransform::scaleExtrusion(double factor)
+{
+    mExtrusionScale *= factor;
+    return *this;
+}
+
+bool GTransform::hasXY() const
+{
+    return mM11 != 1.0 || mM12 != 0.0 || mM21 != 0.0 || mM22 != 1.0 || mDX != 0.0 || mDY != 0.0;
+}
+
+// The columns of the matrix are orthogonal and of the same length
+bool GTransform::isUniform() const
+{
+    const double epsilon = 1e-9;
+    double a = mM11 * mM11 + mM21 * mM21;
+    double b = mM12 * mM12 + mM22 * mM22;
+    return qAbs(a - b) <= epsilon * qMax(a, b) && qAbs(mM11 * mM12 + mM21 * mM22) <= epsilon * qMax(a, b);
+}
+
+double GTransform::scaleFactor() const
+{
+    return qSqrt(qAbs(mM11 * mM22 - mM12 * mM21));
+}
+
+bool GTransform::hasFeedrate() const
+{
+    return mFeedrateScale != 1.0 || mFeedrateMin > 0.0 || mFeedrateMax < std::numeric_limits<double>::max();
+}
+
+QPointF GTransform::map(const QPointF &p) const
+{
+    return QPointF(mM11 * p.x() + mM12 * p.y() + mDX, mM21 * p.x() + mM22 * p.y() + mDY);
+}
+
+QPointF GTransform::mapVector(const QPointF &v) const
+{
+    return QPointF(mM11 * v.x() + mM12 * v.y(), mM21 * v.x() + mM22 * v.y());
+}
+
+double GTransform::mapFeedrate(double f) const
+{
+    return qBound(mFeedrateMin, mFeedrateScale * f, mFeedrateMax);
+}
+
+// Left multiplication, the new operation applies to the result of the chain
+void GTransform::multiply(double m11, double m12, double m21, double m22, double dx, double dy)
+{
+    double n11 = m11 * mM11 + m12 * mM21;
+    double n12 = m11 * mM12 + m12 * mM22;
+    double n21 = m21 * mM11 + m22 * mM21;
+    double n22 = m21 * mM12 + m22 * mM22;
+    double ndx = m11 * mDX + m12 * mDY + dx;
+    double ndy = m21 * mDX + m22 * mDY + dy;
+    
+    mM11 = n11;
+    mM12 = n12;
+    mM21 = n21;
+    mM22 = n22;
+    mDX = ndx;
+    mDY = ndy;
+}
@@ -0,0 +1,53 @@
+#ifndef GTRANSFORM_H
+#define GTRANSFORM_H
+
+#include <QPointF>
+
+// A chain of move transforms, composed into one operation as they are
+// added: an affine map of XY, a scale and offset of Z, a feedrate scale
+// with bounds and an extrusion scale. See GCode::transform().
+class GTransform
+{
+public:
+    GTransform();
+    
+    // XYZ, applied after the operations added before
+    GTransform& translate(double dx, double dy, double dz = 0.0);
+    GTransform& scale(double sx, double sy, double sz = 1.0);
+    GTransform& rotate(double degrees, double cx = 0.0, double cy = 0.0); // Counterclockwise around the center
+    
+    // Feedrates, in the units of the file
+    GTransform& scaleFeedrate(double factor);
+    GTransform& clampFeedrate(double min, double max);
+    
+    // Extrusions only, retracts and primes keep their length
+    GTransform& scaleExtrusion(double factor);
+    
+    bool hasXY() const;
+    bool hasZ() const { return mZScale != 1.0 || mZOffset != 0.0; }
+    bool hasFeedrate() const;
+    bool hasExtrusion() const { return mExtrusionScale != 1.0; }
+    bool isIdentity() const { return !hasXY() && !hasZ() && !hasFeedrate() && !hasExtrusion(); }
+    bool isMirroring() const { return mM11 * mM22 - mM12 * mM21 < 0.0; }
+    bool isUniform() const; // Circles stay circles: rotations, mirrors and equal XY scales
+    double scaleFactor() const; // Of lengths in XY, when uniform
+    
+    QPointF map(const QPointF &p) const;
+    QPointF mapVector(const QPointF &v) const; // Without the translation, for relative moves and arc centers
+    double mapZ(double z) const { return mZScale * z + mZOffset; }
+    double mapZVector(double dz) const { return mZScale * dz; }
+    double mapFeedrate(double f) const;
+    double extrusionScale() const { return mExtrusionScale; }
+
+private:
+    void multiply(double m11, double m12, double m21, double m22, double dx, double dy);
+    
+    // x' = m11 * x + m12 * y + dx, y' = m21 * x + m22 * y + dy
+    double mM11, mM12, mM21, mM22;
+    double mDX, mDY;
+    double mZScale, mZOffset;
+    double mFeedrateScale, mFeedrateMin, mFeedrateMax;
+    double mExtrusionScale;
+};
+
+#endif // GTRANSFORM_H
@@ -0,0 +1,119 @@
+#include "gttydevice.h"
+
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+GTtyDevice::GTtyDevice(const QString &portName, QObject *parent)
+    : QIODevice(parent),
+      mPortName(portName),
+      mFd(-1),
+      mNotifier(NULL)
+{
+}
+
+GTtyDevice::~GTtyDevice()
+{
+    close();
+}
+
+bool GTtyDevice::open(QIODevice::OpenMode mode)
+{
+    if (isOpen()) {
+        return false;
+    }
+    
+    mFd = ::open(mPortName.toLocal8Bit().constData(), O_RDWR | O_NOCTTY);
+    if (mFd < 0) {
+        setErrorString(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+    
+    termios tio;
+    if (tcgetattr(mFd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(mFd, TCSANOW, &tio);
+    }
+    
+    mBuffer.clear();
+    mNotifier = new QSocketNotifier(mFd, QSocketNotifier::Read, this);
+    connect(mNotifier, SIGNAL(activated(int)), this, SLOT(readPort()));
+    
+    // Lines are kept in mBuffer
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void GTtyDevice::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    
+    QIODevice::close();
+    delete mNotifier;
+    mNotifier = NULL;
+    ::close(mFd);
+    mFd = -1;
+}
+
+qint64 GTtyDevice::bytesAvailable() const
+{
+    return mBuffer.size() + QIODevice::bytesAvailable();
+}
+
+bool GTtyDevice::canReadLine() const
+{
+    return mBuffer.contains('\n') || QIODevice::canReadLine();
+}
+
+qint64 GTtyDevice::readData(char *data, qint64 maxSize)
+{
+    int size = int(qMin(maxSize, qint64(mBuffer.size())));
+    memcpy(data, mBuffer.constData(), size);
+    mBuffer.remove(0, size);
+    return size;
+}
+
+// The descriptor blocks, so the whole data is written
+qint64 GTtyDevice::writeData(const char *data, qint64 maxSize)
+{
+    qint64 written = 0;
+    while (written < maxSize) {
+        ssize_t n = ::write(mFd, data + written, maxSize - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            setErrorString(QString::fromLocal8Bit(strerror(errno)));
+            return written > 0 ? written : -1;
+        }
+        written += n;
+    }
+    return written;
+}
+
+// Called when the descriptor is readable, so the read does not block
+void GTtyDevice::readPort()
+{
+    char data[4096];
+    ssize_t n = ::read(mFd, data, sizeof(data));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    
+    // The notifier fires as long as the end of file or the error stands
+    if (n <= 0) {
+        setErrorString(n == 0 ? QString("End of file") : QString::fromLocal8Bit(strerror(errno)));
+        mNotifier->setEnabled(false);
+        emit readChannelFinished();
+        return;
+    }
+    
+    mBuffer.append(data, int(n));
+    emit readyRead();
+}
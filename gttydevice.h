@@ -0,0 +1,40 @@
+#ifndef GTTYDEVICE_H
+#define GTTYDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+
+class QSocketNotifier;
+
+// A serial port or a pseudo terminal in raw mode, for GSender. The
+// baud rate of a real port is left as it is.
+class GTtyDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit GTtyDevice(const QString &portName, QObject *parent = 0);
+    ~GTtyDevice();
+    
+    QString portName() const { return mPortName; }
+    
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const { return true; }
+    qint64 bytesAvailable() const;
+    bool canReadLine() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private slots:
+    void readPort();
+
+private:
+    QString mPortName;
+    int mFd;
+    QSocketNotifier *mNotifier;
+    QByteArray mBuffer; // Received, not read yet
+};
+
+#endif // GTTYDEVICE_H
@@ -0,0 +1,83 @@
+#include "gvertexbuffer.h"
+
+#include <QtConcurrent>
+
+GVertexBuffer::GVertexBuffer(GNavigator *navigator)
+    : mNavigator(navigator),
+      mRevision(-1)
+{
+}
+
+bool GVertexBuffer::update()
+{
+    GCode *gcode = mNavigator->gcode();
+    if (mRevision == gcode->revision()) {
+        return false;
+    }
+    
+    GNavigatorItem *root = mNavigator->root();
+    int size = gcode->movesCount() > 0 ? root->childCount() : 0;
+    
+    // Layers keep their vectors, so the allocations are reused on refill
+    mLayers.resize(size);
+    for (int i = 0; i < size; ++i) {
+        GNavigatorItem *item = root->child(i);
+        Layer &layer = mLayers[i];
+        int first = gcode->lineToMoveForward(item->firstLine());
+        
+        // A layer without moves, the lookups fall back to a move of another one
+        if (first >= 0 && gcode->moveToLine(first) <= item->lastLine()) {
+            layer.firstMove = first;
+            layer.lastMove = gcode->lineToMoveBackward(item->lastLine());
+        } else {
+            layer.firstMove = 0;
+            layer.lastMove = -1;
+        }
+    }
+    
+    QtConcurrent::blockingMap(mLayers, [this](Layer &layer) { fillLayer(layer); });
+    
+    mRevision = gcode->revision();
+    return true;
+}
+
+void GVertexBuffer::invalidate()
+{
+    mRevision = -1;
+}
+
+int GVertexBuffer::vertexCount(int layer) const
+{
+    Q_ASSERT(layer >= 0 && layer < mLayers.size());
+    return mLayers.at(layer).vertices.size() / GCode::VertexSize;
+}
+
+const float *GVertexBuffer::data(int layer) const
+{
+    Q_ASSERT(layer >= 0 && layer < mLayers.size());
+    return mLayers.at(layer).vertices.constData();
+}
+
+int GVertexBuffer::firstMove(int layer) const
+{
+    Q_ASSERT(layer >= 0 && layer < mLayers.size());
+    return mLayers.at(layer).firstMove;
+}
+
+int GVertexBuffer::lastMove(int layer) const
+{
+    Q_ASSERT(layer >= 0 && layer < mLayers.size());
+    return mLayers.at(layer).lastMove;
+}
+
+void GVertexBuffer::fillLayer(Layer &layer) const
+{
+    int count = layer.lastMove - layer.firstMove + 1;
+    if (layer.firstMove < 0 || count <= 0) {
+        layer.vertices.resize(0);
+        return;
+    }
+    
+    layer.vertices.resize(count * GCode::VertexSize);
+    mNavigator->gcode()->exportVertices(layer.firstMove, layer.lastMove, layer.vertices.data());
+}
@@ -0,0 +1,40 @@
+#ifndef GVERTEXBUFFER_H
+#define GVERTEXBUFFER_H
+
+#include <QVector>
+
+#include "gcode.h"
+#include "gnavigator.h"
+
+// Packed per layer vertex arrays for renderers. Every vertex is
+// GCode::VertexSize floats laid out as described by GCode::VertexAttribute.
+class GVertexBuffer
+{
+public:
+    explicit GVertexBuffer(GNavigator *navigator);
+    
+    bool update(); // Refills the buffers if the data has changed
+    void invalidate();
+    
+    int layersCount() const { return mLayers.size(); }
+    int vertexCount(int layer) const;
+    const float* data(int layer) const;
+    int firstMove(int layer) const;
+    int lastMove(int layer) const;
+    
+private:
+    struct Layer {
+        Layer() : firstMove(0), lastMove(-1) {}
+        int firstMove;
+        int lastMove;
+        QVector<float> vertices;
+    };
+    
+    void fillLayer(Layer &layer) const;
+    
+    GNavigator *mNavigator;
+    QVector<Layer> mLayers;
+    int mRevision;
+};
+
+#endif // GVERTEXBUFFER_H
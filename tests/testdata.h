@@ -0,0 +1,38 @@
+#ifndef TESTDATA_H
+#define TESTDATA_H
+
+#include <QByteArray>
+#include <QtMath>
+
+// Slicer like output: a header, then layers of a circle of extrusions
+// with a retract, a travel and a prime. Parameters are separated by
+// single spaces, as MeatPack restores them.
+inline QByteArray sampleGCode(int layers)
+{
+    QByteArray text;
+    text += "; generated for the tests\n";
+    text += "M140 S60\nM104 S210\nG28\nG90\nM82\nG92 E0\n";
+    
+    double e = 0.0;
+    for (int layer = 0; layer < layers; ++layer) {
+        text += ";LAYER:" + QByteArray::number(layer) + "\n";
+        text += "G1 Z" + QByteArray::number(0.2 * (layer + 1), 'f', 2) + " F3000\n";
+        text += ";TYPE:WALL-OUTER\n";
+        for (int i = 0; i < 200; ++i) {
+            double a = 2.0 * M_PI * i / 200;
+            e += 0.03125;
+            text += "G1 X" + QByteArray::number(100.0 + 40.0 * qCos(a), 'f', 3)
+                    + " Y" + QByteArray::number(100.0 + 40.0 * qSin(a), 'f', 3)
+                    + " E" + QByteArray::number(e, 'f', 5) + "\n";
+        }
+        text += "G1 E" + QByteArray::number(e - 0.8, 'f', 5) + " F2100\n";
+        text += "G0 F9000 X60 Y100\n";
+        text += "G1 E" + QByteArray::number(e, 'f', 5) + " F2100\n";
+        text += "M106 S255\n";
+    }
+    
+    text += "M107\nM104 S0\nM140 S0\n";
+    return text;
+}
+
+#endif // TESTDATA_H
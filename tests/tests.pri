@@ -0,0 +1,15 @@
+QT       -= gui
+QT       += testlib concurrent
+
+TEMPLATE = app
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/..
+HEADERS += $$PWD/testdata.h
+
+# The library is built first from gcodelib.pro, by default in the parent
+# of the tests build directory
+isEmpty(GCODELIB_BUILD): GCODELIB_BUILD = $$OUT_PWD/../..
+LIBS += -L$$GCODELIB_BUILD -lgcodelib -lz
+unix: PRE_TARGETDEPS += $$GCODELIB_BUILD/libgcodelib.a
@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+
+# Built against the library of gcodelib.pro, see tests.pri
+SUBDIRS += tst_ganomalydetector \
+    tst_garcwelder \
+    tst_gbgcode \
+    tst_gcodediff \
+    tst_gcodewriter \
+    tst_gmeatpack \
+    tst_gnavigator
+
+# The tty device and the printer simulator are built on unix only
+unix: SUBDIRS += tst_gsender
@@ -0,0 +1,105 @@
+#include <QtTest>
+
+#include "ganomalydetector.h"
+#include "gcode.h"
+#include "testdata.h"
+
+class TestGAnomalyDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void clean();
+    void seededPrime();
+    void seededStorm();
+
+private:
+    static QVector<GAnomaly> detect(const QStringList &lines);
+    static double e(const QString &line);
+    
+    QStringList mLines;
+};
+
+void TestGAnomalyDetector::initTestCase()
+{
+    mLines = QString::fromUtf8(sampleGCode(5)).split('\n');
+}
+
+// The retract and prime rules only
+QVector<GAnomaly> TestGAnomalyDetector::detect(const QStringList &lines)
+{
+    GAnomalyRules rules;
+    rules.types = GAnomaly::RetractStorm | GAnomaly::ZeroLengthExtrusion;
+    GAnomalyDetector detector(rules);
+    
+    GCode gcode;
+    gcode.addObserver(&detector);
+    if (!gcode.readText(lines.join('\n'))) {
+        return QVector<GAnomaly>();
+    }
+    gcode.removeObserver(&detector);
+    
+    return detector.findings();
+}
+
+// The E of a "G1 E<e> F2100" line
+double TestGAnomalyDetector::e(const QString &line)
+{
+    return line.split(' ').at(1).mid(1).toDouble();
+}
+
+// A retract, a travel and a prime of the same length every layer
+void TestGAnomalyDetector::clean()
+{
+    QVERIFY(detect(mLines).isEmpty());
+}
+
+// The prime of the third layer pushes 0.7 mm more than was retracted, the
+// position is set back after it
+void TestGAnomalyDetector::seededPrime()
+{
+    QStringList lines = mLines;
+    int prime = lines.indexOf(";LAYER:3") - 2;
+    QVERIFY(lines.at(prime).startsWith("G1 E"));
+    
+    double position = e(lines.at(prime));
+    lines[prime] = QString("G1 E%1 F2100").arg(position + 0.7, 0, 'f', 5);
+    lines.insert(prime + 1, QString("G92 E%1").arg(position, 0, 'f', 5));
+    
+    QVector<GAnomaly> findings = detect(lines);
+    QCOMPARE(findings.size(), 1);
+    QCOMPARE(findings.first().type, GAnomaly::ZeroLengthExtrusion);
+    QCOMPARE(findings.first().line, prime);
+    QVERIFY(qAbs(findings.first().value - 0.7) < 1e-4);
+}
+
+// Twelve retracts and primes in a row after the prime of the second layer,
+// reported once when ten retracts fall within the window
+void TestGAnomalyDetector::seededStorm()
+{
+    QStringList lines = mLines;
+    int prime = lines.indexOf(";LAYER:2") - 2;
+    QVERIFY(lines.at(prime).startsWith("G1 E"));
+    
+    double position = e(lines.at(prime));
+    QStringList storm;
+    for (int i = 0; i < 12; ++i) {
+        storm.append(QString("G1 E%1").arg(position - 0.8, 0, 'f', 5));
+        storm.append(QString("G1 E%1").arg(position, 0, 'f', 5));
+    }
+    for (int i = 0; i < storm.size(); ++i) {
+        lines.insert(prime + 1 + i, storm.at(i));
+    }
+    
+    QVector<GAnomaly> findings = detect(lines);
+    QCOMPARE(findings.size(), 1);
+    QCOMPARE(findings.first().type, GAnomaly::RetractStorm);
+    QVERIFY(findings.first().line > prime && findings.first().line <= prime + storm.size());
+    QCOMPARE(findings.first().value, 10.0f);
+}
+
+QTEST_GUILESS_MAIN(TestGAnomalyDetector)
+
+#include "tst_ganomalydetector.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_ganomalydetector
+
+SOURCES += tst_ganomalydetector.cpp
@@ -0,0 +1,127 @@
+#include <QtTest>
+#include <QtMath>
+
+#include "garcwelder.h"
+#include "gcode.h"
+#include "gcodewriter.h"
+#include "gnavigator.h"
+
+class TestGArcWelder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void weld_data();
+    void weld();
+
+private:
+    static QPointF point(double degrees);
+    
+    QVector<QPointF> mPoints; // Of the lines welded
+};
+
+static const int Segments = 24;
+static const double SegmentE = 0.02;
+
+// On the circle of radius 40 around 100, 100
+QPointF TestGArcWelder::point(double degrees)
+{
+    double a = qDegreesToRadians(degrees);
+    return QPointF(100.0 + 40.0 * qCos(a), 100.0 + 40.0 * qSin(a));
+}
+
+void TestGArcWelder::weld_data()
+{
+    QTest::addColumn<bool>("relativeE");
+    
+    QTest::newRow("M82") << false;
+    QTest::newRow("M83") << true;
+}
+
+// A quarter counterclockwise from 0 degrees and a quarter clockwise from
+// 180 degrees, each sampled in lines of the same extrusion
+void TestGArcWelder::weld()
+{
+    QFETCH(bool, relativeE);
+    
+    QString text("G21\nG90\n");
+    text += relativeE ? "M83\n" : "M82\n";
+    text += "G92 E0\nG1 Z0.2 F3000\n";
+    
+    double e = 0.0;
+    mPoints.clear();
+    for (int run = 0; run < 2; ++run) {
+        double from = run == 0 ? 0.0 : 180.0;
+        double step = run == 0 ? 90.0 / Segments : -90.0 / Segments;
+        QPointF p = point(from);
+        text += QString("G0 X%1 Y%2\n").arg(p.x(), 0, 'f', 3).arg(p.y(), 0, 'f', 3);
+        mPoints.append(p);
+        
+        for (int i = 1; i <= Segments; ++i) {
+            p = point(from + i * step);
+            e += SegmentE;
+            text += QString("G1 X%1 Y%2 E%3\n").arg(p.x(), 0, 'f', 3).arg(p.y(), 0, 'f', 3)
+                    .arg(relativeE ? SegmentE : e, 0, 'f', 5);
+            mPoints.append(p);
+        }
+    }
+    
+    GCode gcode;
+    QVERIFY(gcode.readText(text));
+    GNavigator navigator(&gcode);
+    
+    GArcWelder welder(&navigator);
+    QCOMPARE(welder.weld(), 2);
+    QCOMPARE(welder.linesReplaced(), 2 * Segments);
+    
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    GCodeWriter writer(&gcode);
+    welder.apply(&writer);
+    QVERIFY(writer.write(&buffer));
+    
+    GCode welded;
+    QVERIFY(welded.readText(QString::fromUtf8(buffer.data())));
+    
+    QStringList codes;
+    for (int l = 0; l < welded.linesCount(); ++l) {
+        QString code = welded.code(l);
+        if (code != "G2" && code != "G3") {
+            continue;
+        }
+        
+        int arc = codes.size();
+        codes.append(code);
+        int m = welded.lineToMove(l);
+        QVERIFY(m > 0);
+        
+        // The center is relative to the start
+        GCodeLine line = welded.line(l);
+        GMove start = welded.move(m - 1);
+        GMove end = welded.move(m);
+        QPointF center(start.X() + line.parameter('I'), start.Y() + line.parameter('J'));
+        double r = qSqrt(qPow(start.X() - center.x(), 2) + qPow(start.Y() - center.y(), 2));
+        QVERIFY(qAbs(center.x() - 100.0) < 0.01 && qAbs(center.y() - 100.0) < 0.01);
+        QVERIFY(qAbs(r - 40.0) < 0.01);
+        
+        // Ends where the lines ended, every point replaced on the arc
+        const QPointF &last = mPoints.at((arc + 1) * (Segments + 1) - 1);
+        QVERIFY(qAbs(end.X() - last.x()) < 1e-3 && qAbs(end.Y() - last.y()) < 1e-3);
+        for (int i = arc * (Segments + 1); i < (arc + 1) * (Segments + 1); ++i) {
+            QPointF v = mPoints.at(i) - center;
+            QVERIFY(qAbs(qSqrt(v.x() * v.x() + v.y() * v.y()) - r) <= welder.tolerance());
+        }
+        
+        // The extrusion of the lines replaced
+        QVERIFY(qAbs(end.ET() - (arc + 1) * Segments * SegmentE) < 1e-4);
+    }
+    QCOMPARE(codes, QStringList() << "G3" << "G2");
+    
+    GMove lastMove = gcode.move(gcode.movesCount() - 1);
+    GMove lastWelded = welded.move(welded.movesCount() - 1);
+    QVERIFY(qAbs(lastWelded.ET() - lastMove.ET()) < 1e-4);
+}
+
+QTEST_GUILESS_MAIN(TestGArcWelder)
+
+#include "tst_garcwelder.moc"
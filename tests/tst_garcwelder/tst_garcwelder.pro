@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_garcwelder
+
+SOURCES += tst_garcwelder.cpp
@@ -0,0 +1,242 @@
+#include <QtTest>
+#include <QBuffer>
+#include <QTemporaryDir>
+
+#include "gbgcode.h"
+#include "gbgcodereader.h"
+#include "gbgcodewriter.h"
+#include "gcode.h"
+#include "gcodewriter.h"
+#include "testdata.h"
+
+class TestGBgcode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void roundTrip_data();
+    void roundTrip();
+    void gcodeRoundTrip();
+    void corruptBlock();
+    void heatshrinkDecode_data();
+    void heatshrinkDecode();
+    
+    void benchmarkRead_data();
+    void benchmarkRead();
+    void benchmarkWrite_data();
+    void benchmarkWrite();
+
+private:
+    static QByteArray encode(const QByteArray &text, GBgcode::Compression compression, bool meatPack);
+    static QByteArray decode(const QByteArray &data, bool *ok);
+    
+    QTemporaryDir mDir;
+    QByteArray mText;
+};
+
+// Spans several G-code blocks
+void TestGBgcode::initTestCase()
+{
+    QVERIFY(mDir.isValid());
+    mText = sampleGCode(50);
+    QVERIFY(mText.size() > 3 * GBgcodeWriter::BlockSize);
+    
+    QFile text(mDir.path() + "/sample.gcode");
+    QVERIFY(text.open(QIODevice::WriteOnly));
+    text.write(mText);
+    text.close();
+    
+    QFile plain(mDir.path() + "/plain.bgcode");
+    QVERIFY(plain.open(QIODevice::WriteOnly));
+    plain.write(encode(mText, GBgcode::NoCompression, false));
+    plain.close();
+    
+    QFile packed(mDir.path() + "/packed.bgcode");
+    QVERIFY(packed.open(QIODevice::WriteOnly));
+    packed.write(encode(mText, GBgcode::Deflate, true));
+    packed.close();
+}
+
+void TestGBgcode::roundTrip_data()
+{
+    QTest::addColumn<int>("compression");
+    QTest::addColumn<bool>("meatPack");
+    
+    QTest::newRow("plain") << int(GBgcode::NoCompression) << false;
+    QTest::newRow("deflate") << int(GBgcode::Deflate) << false;
+    QTest::newRow("meatpack") << int(GBgcode::NoCompression) << true;
+    QTest::newRow("deflate meatpack") << int(GBgcode::Deflate) << true;
+}
+
+void TestGBgcode::roundTrip()
+{
+    QFETCH(int, compression);
+    QFETCH(bool, meatPack);
+    
+    QByteArray data = encode(mText, GBgcode::Compression(compression), meatPack);
+    QVERIFY(GBgcodeReader::isBgcode(data.left(4)));
+    
+    bool ok = false;
+    QByteArray text = decode(data, &ok);
+    QVERIFY(ok);
+    QCOMPARE(text, mText);
+}
+
+// Through the GCodeWriter binary format and the GCode reader
+void TestGBgcode::gcodeRoundTrip()
+{
+    GCode gcode;
+    QVERIFY(gcode.readText(QString::fromUtf8(mText)));
+    
+    QString fileName = mDir.path() + "/written.bgcode";
+    GCodeWriter writer(&gcode);
+    writer.setFormat(GCodeWriter::Binary);
+    QVERIFY2(writer.writeFile(fileName), qPrintable(writer.errorString()));
+    
+    GCode read;
+    QVERIFY(read.readFile(fileName));
+    QCOMPARE(read.linesCount(), gcode.linesCount());
+    for (int l = 0; l < gcode.linesCount(); ++l) {
+        QCOMPARE(read.text(l), gcode.text(l));
+    }
+    QCOMPARE(read.movesCount(), gcode.movesCount());
+}
+
+void TestGBgcode::corruptBlock()
+{
+    QByteArray data = encode(mText, GBgcode::Deflate, true);
+    data[data.size() - 10] = char(data.at(data.size() - 10) ^ 0x55);
+    
+    bool ok = true;
+    decode(data, &ok);
+    QVERIFY(!ok);
+}
+
+// Fixed streams, encoded apart from the reader with the match search of the
+// heatshrink encoder: the longest match of at least 3 bytes, the nearest first
+void TestGBgcode::heatshrinkDecode_data()
+{
+    QTest::addColumn<int>("windowBits");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("valid");
+    
+    QByteArray data11 = QByteArray::fromHex("a3cc6415898cc241590032a2cc25d35850079cc803da632e98007c00"
+                                            "19007900fa81798079cc807d80fde6403e40");
+    QByteArray data12 = QByteArray::fromHex("a3cc6415898cc241590019516612e9ac2801e732007b4c65d30007c0"
+                                            "00c801e401f50179803ce6401f601fbcc803e4");
+    
+    QTest::newRow("window 11") << 11 << data11 << 80 << true;
+    QTest::newRow("window 12") << 12 << data12 << 80 << true;
+    QTest::newRow("short") << 12 << data12 << 81 << false;
+    QTest::newRow("truncated") << 12 << data12.left(30) << 80 << false;
+}
+
+void TestGBgcode::heatshrinkDecode()
+{
+    QFETCH(int, windowBits);
+    QFETCH(QByteArray, data);
+    QFETCH(int, size);
+    QFETCH(bool, valid);
+    
+    QByteArray text("G1 X10 Y10 E0.5\n"
+                    "G1 X20 Y10 E1.0\n"
+                    "G1 X20 Y20 E1.5\n"
+                    "G1 X10 Y20 E2.0\n"
+                    "G1 X10 Y10 E2.5\n");
+    
+    QByteArray out;
+    QCOMPARE(GBgcode::heatshrinkDecode(data, windowBits, 4, size, &out), valid);
+    if (valid) {
+        QCOMPARE(out, text);
+    } else {
+        QVERIFY(text.startsWith(out));
+    }
+}
+
+void TestGBgcode::benchmarkRead_data()
+{
+    QTest::addColumn<QString>("fileName");
+    
+    QTest::newRow("text") << QString("sample.gcode");
+    QTest::newRow("bgcode") << QString("plain.bgcode");
+    QTest::newRow("bgcode deflate meatpack") << QString("packed.bgcode");
+}
+
+void TestGBgcode::benchmarkRead()
+{
+    QFETCH(QString, fileName);
+    
+    QString path = mDir.path() + "/" + fileName;
+    QBENCHMARK {
+        GCode gcode;
+        gcode.readFile(path);
+    }
+}
+
+void TestGBgcode::benchmarkWrite_data()
+{
+    QTest::addColumn<int>("format");
+    
+    QTest::newRow("text") << int(GCodeWriter::Text);
+    QTest::newRow("bgcode") << int(GCodeWriter::Binary);
+}
+
+void TestGBgcode::benchmarkWrite()
+{
+    QFETCH(int, format);
+    
+    GCode gcode;
+    QVERIFY(gcode.readText(QString::fromUtf8(mText)));
+    
+    qint64 size = 0;
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        GCodeWriter writer(&gcode);
+        writer.setFormat(GCodeWriter::Format(format));
+        writer.write(&buffer);
+        size = buffer.size();
+    }
+    qDebug() << "Output" << size << "bytes of" << mText.size();
+}
+
+QByteArray TestGBgcode::encode(const QByteArray &text, GBgcode::Compression compression, bool meatPack)
+{
+    QByteArray data;
+    QBuffer target(&data);
+    target.open(QIODevice::WriteOnly);
+    
+    GBgcodeWriter writer(&target);
+    writer.setCompression(compression);
+    writer.setMeatPack(meatPack);
+    writer.addMetadata(GBgcode::PrinterMetadata, "printer_model", "test");
+    if (!writer.open(QIODevice::WriteOnly)) {
+        return QByteArray();
+    }
+    writer.write(text);
+    writer.close();
+    return data;
+}
+
+QByteArray TestGBgcode::decode(const QByteArray &data, bool *ok)
+{
+    QBuffer source;
+    source.setData(data);
+    source.open(QIODevice::ReadOnly);
+    
+    GBgcodeReader reader(&source);
+    if (!reader.open(QIODevice::ReadOnly)) {
+        *ok = false;
+        return QByteArray();
+    }
+    QByteArray text = reader.readAll();
+    *ok = !reader.hasError();
+    return text;
+}
+
+QTEST_GUILESS_MAIN(TestGBgcode)
+
+#include "tst_gbgcode.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gbgcode
+
+SOURCES += tst_gbgcode.cpp
@@ -0,0 +1,102 @@
+#include <QtTest>
+
+#include "gcode.h"
+#include "gcodediff.h"
+#include "testdata.h"
+
+class TestGCodeDiff : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void equal();
+    void knownEdits();
+
+private:
+    static QString moved(const QString &line, int field, double delta, int decimals);
+    
+    QStringList mLines;
+};
+
+void TestGCodeDiff::initTestCase()
+{
+    mLines = QString::fromUtf8(sampleGCode(5)).split('\n');
+}
+
+// The line with a number of its fields moved by delta
+QString TestGCodeDiff::moved(const QString &line, int field, double delta, int decimals)
+{
+    QStringList fields = line.split(' ');
+    QString value = fields.at(field);
+    fields[field] = value.left(1) + QString::number(value.mid(1).toDouble() + delta, 'f', decimals);
+    return fields.join(' ');
+}
+
+void TestGCodeDiff::equal()
+{
+    GCode a;
+    GCode b;
+    QVERIFY(a.readText(mLines.join('\n')));
+    QVERIFY(b.readText(mLines.join('\n')));
+    
+    GCodeDiff diff(&a, &b);
+    diff.compare();
+    QVERIFY(diff.isEqual());
+    QVERIFY(diff.hunks().isEmpty());
+    QVERIFY(diff.numericChanges().isEmpty());
+}
+
+// A moved point, edits under the tolerance or in the formatting and the
+// comments only, and an inserted line in the next layer
+void TestGCodeDiff::knownEdits()
+{
+    QStringList lines = mLines;
+    
+    int layer2 = lines.indexOf(";LAYER:2");
+    int layer3 = lines.indexOf(";LAYER:3");
+    QVERIFY(layer2 >= 0 && layer3 > layer2);
+    QCOMPARE(lines.at(layer2 + 1), QString("G1 Z0.60 F3000"));
+    
+    int changed = layer2 + 5;
+    lines[changed] = moved(lines.at(changed), 1, 0.5, 3);
+    lines[changed + 2] = moved(lines.at(changed + 2), 1, 0.0, 4);
+    lines[changed + 4] += " ; note";
+    lines[changed + 6] = moved(lines.at(changed + 6), 2, 0.0005, 4);
+    
+    int inserted = layer3 + 2;
+    lines.insert(inserted, "M106 S128");
+    
+    GCode a;
+    GCode b;
+    QVERIFY(a.readText(mLines.join('\n')));
+    QVERIFY(b.readText(lines.join('\n')));
+    
+    GCodeDiff diff(&a, &b);
+    diff.compare();
+    QVERIFY(!diff.isEqual());
+    
+    QCOMPARE(diff.layerChanges().size(), 2);
+    QVERIFY(qAbs(diff.layerChanges().at(0).z - 0.6) < 1e-9);
+    QVERIFY(qAbs(diff.layerChanges().at(1).z - 0.8) < 1e-9);
+    
+    QCOMPARE(diff.numericChanges().size(), 1);
+    const GCodeDiff::NumericChange &change = diff.numericChanges().first();
+    QCOMPARE(change.lineA, changed);
+    QCOMPARE(change.lineB, changed);
+    QVERIFY(change.parameter == 'X');
+    QVERIFY(qAbs(change.b - change.a - 0.5) < 1e-9);
+    
+    // Empty on the side of the first document
+    QCOMPARE(diff.hunks().size(), 1);
+    const GCodeDiff::Hunk &hunk = diff.hunks().first();
+    QCOMPARE(hunk.firstA, inserted);
+    QCOMPARE(hunk.lastA, inserted - 1);
+    QCOMPARE(hunk.firstB, inserted);
+    QCOMPARE(hunk.lastB, inserted);
+}
+
+QTEST_GUILESS_MAIN(TestGCodeDiff)
+
+#include "tst_gcodediff.moc"
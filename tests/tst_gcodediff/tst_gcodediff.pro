@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gcodediff
+
+SOURCES += tst_gcodediff.cpp
@@ -0,0 +1,69 @@
+#include <QtTest>
+
+#include "gcode.h"
+#include "gcodewriter.h"
+
+class TestGCodeWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unmodifiedLines();
+    void editedLines_data();
+    void editedLines();
+
+private:
+    static QByteArray write(const GCode &gcode);
+};
+
+QByteArray TestGCodeWriter::write(const GCode &gcode)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    GCodeWriter writer(&gcode);
+    if (!writer.write(&buffer)) {
+        return QByteArray();
+    }
+    
+    return buffer.data();
+}
+
+void TestGCodeWriter::unmodifiedLines()
+{
+    QString text("G28 X Y\nG1 X1.50000 Y2 ; comment\nM117 Hello\n");
+    GCode gcode;
+    QVERIFY(gcode.readText(text));
+    QCOMPARE(write(gcode), text.toUtf8());
+}
+
+void TestGCodeWriter::editedLines_data()
+{
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<char>("parameter");
+    QTest::addColumn<double>("value");
+    QTest::addColumn<QByteArray>("expected");
+    
+    // Parameters without a value keep their form
+    QTest::newRow("home axes") << "G28 X Y" << 'Z' << 0.0 << QByteArray("G28 X Y Z0");
+    QTest::newRow("disable axis") << "M84 E" << 'S' << 10.0 << QByteArray("M84 E S10");
+    QTest::newRow("numbers") << "G1 X1.50000 Y2" << 'Y' << 2.5 << QByteArray("G1 X1.5 Y2.5");
+    QTest::newRow("comment") << "G1 X1 E ; prime" << 'F' << 1800.0 << QByteArray("G1 X1 E F1800 ;prime");
+}
+
+void TestGCodeWriter::editedLines()
+{
+    QFETCH(QString, line);
+    QFETCH(char, parameter);
+    QFETCH(double, value);
+    QFETCH(QByteArray, expected);
+    
+    GCode gcode;
+    QVERIFY(gcode.readText(line + "\nG1 X0\n"));
+    gcode.setParameter(0, parameter, value);
+    QVERIFY(gcode.modified(0));
+    QCOMPARE(write(gcode), expected + "\nG1 X0\n");
+}
+
+QTEST_GUILESS_MAIN(TestGCodeWriter)
+
+#include "tst_gcodewriter.moc"
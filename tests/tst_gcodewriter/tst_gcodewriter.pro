@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gcodewriter
+
+SOURCES += tst_gcodewriter.cpp
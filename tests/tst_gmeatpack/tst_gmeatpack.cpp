@@ -0,0 +1,197 @@
+#include <QtTest>
+
+#include "gcode.h"
+#include "gmeatpack.h"
+#include "testdata.h"
+
+class TestGMeatPack : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void roundTrip_data();
+    void roundTrip();
+    void parameterSpaces_data();
+    void parameterSpaces();
+    void chunkedDecode_data();
+    void chunkedDecode();
+    void ratio_data();
+    void ratio();
+    void encodeGCode();
+    
+    void benchmarkEncode_data();
+    void benchmarkEncode();
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+
+private:
+    static QByteArray encode(const QByteArray &text, bool noSpaces);
+    
+    QByteArray mText;
+};
+
+void TestGMeatPack::initTestCase()
+{
+    mText = sampleGCode(20);
+}
+
+void TestGMeatPack::roundTrip_data()
+{
+    QTest::addColumn<bool>("noSpaces");
+    
+    QTest::newRow("spaces") << false;
+    QTest::newRow("no spaces") << true;
+}
+
+void TestGMeatPack::roundTrip()
+{
+    QFETCH(bool, noSpaces);
+    
+    GMeatPack decoder;
+    QByteArray text;
+    decoder.decode(encode(mText, noSpaces), &text);
+    QCOMPARE(text, mText);
+}
+
+// Every chunk goes to a fresh buffer, as a serial reader does
+void TestGMeatPack::parameterSpaces_data()
+{
+    roundTrip_data();
+}
+
+// Every letter after the code of a G line gets its space back
+void TestGMeatPack::parameterSpaces()
+{
+    QFETCH(bool, noSpaces);
+    
+    QByteArray lines = "G4 S1\n"
+            "G1 X10 S255\n"
+            "G28 X Y\n"
+            "G29.1 Z0.5\n"
+            "G10 P0 R200 S210 L1\n"
+            "G1 X1 T0 U2 V3 B4 D5 K6 L7 Q8 N9\n"
+            "G1 X10 ; Move A B\n"
+            "GET_POSITION\n"
+            "T0\n"
+            "M106 S255\n";
+    
+    GMeatPack decoder;
+    QByteArray text;
+    decoder.decode(encode(lines, noSpaces), &text);
+    QCOMPARE(text, lines);
+}
+
+void TestGMeatPack::chunkedDecode_data()
+{
+    QTest::addColumn<bool>("noSpaces");
+    QTest::addColumn<int>("chunkSize");
+    
+    for (int size = 1; size <= 7; ++size) {
+        QTest::newRow(qPrintable(QString("spaces %1").arg(size))) << false << size;
+        QTest::newRow(qPrintable(QString("no spaces %1").arg(size))) << true << size;
+    }
+}
+
+void TestGMeatPack::chunkedDecode()
+{
+    QFETCH(bool, noSpaces);
+    QFETCH(int, chunkSize);
+    
+    QByteArray data = encode(mText, noSpaces);
+    GMeatPack decoder;
+    QByteArray text;
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        QByteArray chunk;
+        decoder.decode(data.mid(i, chunkSize), &chunk);
+        text += chunk;
+    }
+    QCOMPARE(text, mText);
+}
+
+void TestGMeatPack::ratio_data()
+{
+    QTest::addColumn<bool>("noSpaces");
+    
+    QTest::newRow("spaces") << false;
+    QTest::newRow("no spaces") << true;
+}
+
+void TestGMeatPack::ratio()
+{
+    QFETCH(bool, noSpaces);
+    
+    GMeatPack encoder(noSpaces);
+    QByteArray data;
+    encoder.encode(mText, &data);
+    QCOMPARE(encoder.textBytes(), qint64(mText.size()));
+    QCOMPARE(encoder.packedBytes(), qint64(data.size()));
+    QVERIFY(encoder.ratio() < 0.75);
+    qDebug() << "Packed to" << encoder.ratio() << "of the text";
+}
+
+// Commands only, without the comments and the empty lines
+void TestGMeatPack::encodeGCode()
+{
+    GCode gcode;
+    QVERIFY(gcode.readText(QString::fromUtf8(mText)));
+    
+    GMeatPack encoder;
+    QByteArray data = encoder.encode(&gcode, 0, gcode.linesCount() - 1);
+    
+    QByteArray expected;
+    for (int l = 0; l < gcode.linesCount(); ++l) {
+        if (!gcode.command(l).isEmpty()) {
+            expected += gcode.command(l).toUtf8() + "\n";
+        }
+    }
+    
+    GMeatPack decoder;
+    QByteArray text;
+    decoder.decode(data, &text);
+    QCOMPARE(text, expected);
+}
+
+void TestGMeatPack::benchmarkEncode_data()
+{
+    roundTrip_data();
+}
+
+void TestGMeatPack::benchmarkEncode()
+{
+    QFETCH(bool, noSpaces);
+    
+    QBENCHMARK {
+        encode(mText, noSpaces);
+    }
+}
+
+void TestGMeatPack::benchmarkDecode_data()
+{
+    roundTrip_data();
+}
+
+void TestGMeatPack::benchmarkDecode()
+{
+    QFETCH(bool, noSpaces);
+    
+    QByteArray data = encode(mText, noSpaces);
+    QBENCHMARK {
+        GMeatPack decoder;
+        QByteArray text;
+        decoder.decode(data, &text);
+    }
+}
+
+QByteArray TestGMeatPack::encode(const QByteArray &text, bool noSpaces)
+{
+    GMeatPack encoder(noSpaces);
+    QByteArray data = encoder.start();
+    encoder.encode(text, &data);
+    return data;
+}
+
+QTEST_GUILESS_MAIN(TestGMeatPack)
+
+#include "tst_gmeatpack.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gmeatpack
+
+SOURCES += tst_gmeatpack.cpp
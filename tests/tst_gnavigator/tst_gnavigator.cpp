@@ -0,0 +1,133 @@
+#include <QtTest>
+
+#include "gcode.h"
+#include "gnavigator.h"
+#include "testdata.h"
+
+class TestGNavigator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void layerTotals();
+    void fetchAll();
+    void editedLayers();
+
+private:
+    static QString info(const GNavigatorItemInfo &info);
+    static void dump(GNavigatorItem *item, QStringList *lines);
+    static QStringList dump(GNavigator *navigator);
+    
+    QString mText;
+};
+
+void TestGNavigator::initTestCase()
+{
+    mText = QString::fromUtf8(sampleGCode(20));
+}
+
+// Doubles in full, the parallel sums must match the serial ones exactly
+QString TestGNavigator::info(const GNavigatorItemInfo &info)
+{
+    return QString("%1 %2 %3 %4 %5").arg(info.z, 0, 'g', 17).arg(info.l, 0, 'g', 17)
+            .arg(info.lE, 0, 'g', 17).arg(info.dE, 0, 'g', 17).arg(info.dEl, 0, 'g', 17);
+}
+
+void TestGNavigator::dump(GNavigatorItem *item, QStringList *lines)
+{
+    lines->append(QString("%1 %2-%3 %4 %5").arg(item->type()).arg(item->firstLine()).arg(item->lastLine())
+                  .arg(item->childCount()).arg(info(item->info())));
+    for (int i = 0; i < item->childCount(); ++i) {
+        dump(item->child(i), lines);
+    }
+}
+
+QStringList TestGNavigator::dump(GNavigator *navigator)
+{
+    QStringList lines;
+    dump(navigator->root(), &lines);
+    return lines;
+}
+
+// The totals summed on the pool, against a serial pass in move order
+void TestGNavigator::layerTotals()
+{
+    GCode gcode;
+    QVERIFY(gcode.readText(mText));
+    GNavigator navigator(&gcode);
+    
+    QList<int> firstLines;
+    QStringList totals;
+    GNavigatorItemInfo layer(0.0);
+    firstLines.append(0);
+    for (int m = 0; m < gcode.movesCount(); ++m) {
+        if (qAbs(gcode.Z(m) - layer.z) > Layers::zTolerance) {
+            totals.append(info(layer));
+            firstLines.append(gcode.moveToLine(m));
+            layer = GNavigatorItemInfo(gcode.Z(m));
+        }
+        
+        double dE = gcode.dEe(m);
+        double dist = gcode.distance(m);
+        layer.l += dist;
+        if (dE != 0) layer.lE += dist;
+        layer.dE += dE;
+        if (dist > 0) layer.dEl += dE;
+    }
+    totals.append(info(layer));
+    
+    GNavigatorItem *root = navigator.root();
+    QCOMPARE(root->childCount(), totals.size());
+    for (int i = 0; i < root->childCount(); ++i) {
+        QCOMPARE(root->child(i)->firstLine(), firstLines.at(i));
+        QCOMPARE(info(root->child(i)->info()), totals.at(i));
+    }
+}
+
+// Children built on the pool, against the layers fetched one by one
+void TestGNavigator::fetchAll()
+{
+    GCode gcode;
+    QVERIFY(gcode.readText(mText));
+    
+    GNavigator parallel(&gcode);
+    parallel.fetchAll();
+    
+    GNavigator serial(&gcode);
+    GNavigatorItem *root = serial.root();
+    for (int i = 0; i < root->childCount(); ++i) {
+        QVERIFY(serial.canFetchMore(root->child(i)));
+        serial.fetchMore(root->child(i));
+    }
+    
+    QCOMPARE(dump(&parallel), dump(&serial));
+}
+
+// The layers updated after an edit, against a navigator built afresh
+void TestGNavigator::editedLayers()
+{
+    GCode gcode;
+    QVERIFY(gcode.readText(mText));
+    GNavigator navigator(&gcode);
+    navigator.fetchAll();
+    
+    // Moves the sixth layer down to the fifth, the two merge
+    int l = 0;
+    while (l < gcode.linesCount() && gcode.text(l) != "G1 Z1.20 F3000") {
+        ++l;
+    }
+    QVERIFY(l < gcode.linesCount());
+    int layers = navigator.root()->childCount();
+    gcode.setParameter(l, 'Z', 1.0);
+    QCOMPARE(navigator.root()->childCount(), layers - 1);
+    
+    GNavigator fresh(&gcode);
+    fresh.fetchAll();
+    QCOMPARE(dump(&navigator), dump(&fresh));
+}
+
+QTEST_GUILESS_MAIN(TestGNavigator)
+
+#include "tst_gnavigator.moc"
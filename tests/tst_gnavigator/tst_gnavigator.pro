@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gnavigator
+
+SOURCES += tst_gnavigator.cpp
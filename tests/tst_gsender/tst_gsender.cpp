@@ -0,0 +1,124 @@
+#include <QtTest>
+
+#include "gcode.h"
+#include "gprintersimulator.h"
+#include "gsender.h"
+#include "gttydevice.h"
+#include "testdata.h"
+
+class TestGSender : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void send_data();
+    void send();
+    void bufferOverflow();
+    void hangUp();
+
+private:
+    GCode mGCode;
+    QList<QByteArray> mCommands; // As the printer executes them
+};
+
+void TestGSender::initTestCase()
+{
+    QVERIFY(mGCode.readText(QString::fromUtf8(sampleGCode(2))));
+    
+    mCommands.append("M110 N0");
+    for (int l = 0; l < mGCode.linesCount(); ++l) {
+        if (!mGCode.command(l).isEmpty()) {
+            mCommands.append(mGCode.command(l).toLatin1());
+        }
+    }
+}
+
+void TestGSender::send_data()
+{
+    QTest::addColumn<int>("flowControl");
+    QTest::addColumn<int>("errorInterval");
+    
+    QTest::newRow("ok counting") << int(GSender::OkCounting) << 0;
+    QTest::newRow("character counting") << int(GSender::CharacterCounting) << 0;
+    QTest::newRow("ok counting, errors") << int(GSender::OkCounting) << 7;
+    QTest::newRow("character counting, errors") << int(GSender::CharacterCounting) << 7;
+}
+
+// Every command is executed once and in order, resends included
+void TestGSender::send()
+{
+    QFETCH(int, flowControl);
+    QFETCH(int, errorInterval);
+    
+    GPrinterSimulator printer;
+    QVERIFY(printer.open());
+    printer.setErrorInterval(errorInterval);
+    QSignalSpy executed(&printer, SIGNAL(commandExecuted(QByteArray)));
+    
+    GTtyDevice port(printer.portName());
+    QVERIFY(port.open(QIODevice::ReadWrite));
+    
+    GSender sender(&mGCode);
+    sender.setFlowControl(GSender::FlowControl(flowControl));
+    QSignalSpy finished(&sender, SIGNAL(finished()));
+    QVERIFY(sender.start(&port));
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 30000);
+    
+    QCOMPARE(sender.linesAcknowledged(), mCommands.size() - 1);
+    QCOMPARE(printer.commandsExecuted(), mCommands.size());
+    QCOMPARE(executed.count(), mCommands.size());
+    for (int i = 0; i < executed.count(); ++i) {
+        QCOMPARE(executed.at(i).at(0).toByteArray(), mCommands.at(i));
+    }
+    
+    QCOMPARE(printer.bytesDropped(), 0);
+    if (errorInterval > 0) {
+        QVERIFY(printer.resendsRequested() > 0);
+        QVERIFY(sender.resends() > 0);
+    } else {
+        QCOMPARE(printer.resendsRequested(), 0);
+        QCOMPARE(sender.resends(), 0);
+    }
+}
+
+// A window past the receive buffer of the firmware loses bytes
+void TestGSender::bufferOverflow()
+{
+    GPrinterSimulator printer;
+    QVERIFY(printer.open());
+    printer.setCommandTime(5);
+    
+    GTtyDevice port(printer.portName());
+    QVERIFY(port.open(QIODevice::ReadWrite));
+    
+    GSender sender(&mGCode);
+    sender.setFlowControl(GSender::CharacterCounting);
+    sender.setBufferSize(4 * printer.bufferSize());
+    QVERIFY(sender.start(&port));
+    QTRY_VERIFY_WITH_TIMEOUT(printer.bytesDropped() > 0, 10000);
+    sender.stop();
+}
+
+void TestGSender::hangUp()
+{
+    GPrinterSimulator printer;
+    QVERIFY(printer.open());
+    
+    GTtyDevice port(printer.portName());
+    QVERIFY(port.open(QIODevice::ReadWrite));
+    QSignalSpy finished(&port, SIGNAL(readChannelFinished()));
+    
+    printer.close();
+    QTRY_COMPARE(finished.count(), 1);
+    QVERIFY(!port.errorString().isEmpty());
+    
+    // The notifier is off, the signal is not repeated
+    QTest::qWait(100);
+    QCOMPARE(finished.count(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestGSender)
+
+#include "tst_gsender.moc"
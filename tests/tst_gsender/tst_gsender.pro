@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_gsender
+
+SOURCES += tst_gsender.cpp